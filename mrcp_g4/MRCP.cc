@@ -35,6 +35,11 @@
 #include "DetectorConstruction.hh"
 #include "PhysicsList.hh"
 #include "ActionInitialization.hh"
+#include "WorkerInitialization.hh"
+#include "NUMAReplica.hh"
+#include "JobServer.hh"
+#include "SAFProducer.hh"
+#include "PhaseSpace.hh"
 
 // G4Runmanager and mandatory classes
 #ifdef G4MULTITHREADED
@@ -43,6 +48,10 @@
 #else
 #include "G4RunManager.hh"
 #endif
+#include "G4Version.hh"
+#if G4VERSION_NUMBER >= 1070
+#include "G4RunManagerFactory.hh"
+#endif
 
 // UI and visualization classes
 #include "G4UImanager.hh"
@@ -54,6 +63,7 @@
 #include "Randomize.hh"
 
 // C++ std lib
+#include <cstdint>
 #include <filesystem>
 
 // --- main() Arguments usage explanation --- //
@@ -68,17 +78,51 @@ void PrintUsage()
         << "\n\t[-o] <Set outfile> default: ""[MACRO].out"", inputtype: string"
         << "\n\t[-p] <Set tetra model file & path> "
         << "\n\t\tdefault: ""$PHANTOM or ../../phantoms/AM_MRCP_skin"", inputtype: string"
+        << "\n\t[-q] <Set protection quantity definition file> "
+        << "\n\t\tdefault: ""[phantom path]/ICRP103.ProtQ"", inputtype: string"
+        << "\n\t[-s] <Set master seed> default: current time, inputtype: int"
+        << "\n\t[-i] <Set shard index> default: 0, inputtype: int"
+        << "\n\t[-g] <Set primary generator> default: ParticleGun, inputtype: ParticleGun|GPS|PhaseSpace"
+        << "\n\t[-j] <Serve jobs from a spool directory (or - for stdin) after the macro> default: off, inputtype: string"
 #ifdef G4MULTITHREADED
         << "\n\t[-t] <Set nThreads> default: 1, inputtype: int, Max: "
         << G4Threading::G4GetNumberOfCores()
+        << "\n\t[-r] <Set run manager type> default: MT, inputtype: MT|Tasking|Serial"
+        << "\n\t[-e] <Set events per communication (task)> default: run manager's, inputtype: int"
+        << "\n\t[-c] <Set seeding> default: 0, inputtype: 0 (per event)|1 (per communication)|2 (per run)"
+        << "\n\t[-n] <Set NUMA mode> default: 0, inputtype: 0 (off)|1 (pin workers per socket)|2 (1 + phantom replica per NUMA node)"
 #endif
         << "\n\t[-u] <Set UISession> default: tcsh, inputtype: string"
         << G4endl;
 }
+
+// SplitMix64, to derive well-separated seeds from (master seed, shard index)
+uint64_t SplitMix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
 }
 
 // --- Global variables for main() arguments --- //
 std::filesystem::path OUTPUT_FILENAME; // Passed to RunAction class.
+G4long MASTER_SEED; // Passed to RunAction class (recorded in the raw tally file).
+G4int SHARD_INDEX;  // Passed to RunAction class (recorded in the raw tally file).
+
+// Seeds of each shard are derived from the master seed and the shard index,
+// so that shards are reproducible and independent of each other.
+// (per-event seeds are drawn from this engine by the MT run manager)
+// Also used by JobServer, for the seed of each job.
+void SetMasterSeed(G4long masterSeed)
+{
+    ::MASTER_SEED = masterSeed;
+    uint64_t shardSeed = SplitMix64(SplitMix64(static_cast<uint64_t>(::MASTER_SEED)) ^ static_cast<uint64_t>(::SHARD_INDEX));
+    long seeds[3] = { static_cast<long>(shardSeed & 0x7fffffff) | 1,
+                      static_cast<long>((shardSeed >> 32) & 0x7fffffff) | 1, 0 };
+    G4Random::setTheSeeds(seeds);
+}
 
 int main(int argc, char** argv)
 {
@@ -88,10 +132,19 @@ int main(int argc, char** argv)
     const char* envVar_PHANTOM = ::getenv("PHANTOM") ;
     if(envVar_PHANTOM != nullptr) // Use if $PHANTOM environment variable exist
         mainPhantom_FilePath = envVar_PHANTOM;
+    std::filesystem::path protQDefinition_FilePath;
 #ifdef G4MULTITHREADED
     G4int nThreads = 1;
+    G4String runManagerType = "MT";
+    G4int eventModulo = 0;
+    G4int seedOncePerCommunication = 0;
+    G4int numaMode = 0;
 #endif
     G4String session = "tcsh";
+    G4String primaryGenerator = "ParticleGun";
+    std::filesystem::path jobSpool_Path;
+    ::MASTER_SEED = time(nullptr);
+    ::SHARD_INDEX = 0;
 
     // --- Parsing main() Arguments --- //
     for(G4int i = 1; i<argc; i += 2)
@@ -99,8 +152,17 @@ int main(int argc, char** argv)
         if(G4String(argv[i])=="-m") macro_FileName = argv[i+1];
         else if(G4String(argv[i])=="-o") ::OUTPUT_FILENAME = argv[i+1];
         else if(G4String(argv[i])=="-p") mainPhantom_FilePath = argv[i+1];
+        else if(G4String(argv[i])=="-q") protQDefinition_FilePath = argv[i+1];
+        else if(G4String(argv[i])=="-s") ::MASTER_SEED = G4UIcommand::ConvertToLongInt(argv[i+1]);
+        else if(G4String(argv[i])=="-i") ::SHARD_INDEX = G4UIcommand::ConvertToInt(argv[i+1]);
+        else if(G4String(argv[i])=="-j") jobSpool_Path = argv[i+1];
+        else if(G4String(argv[i])=="-g") primaryGenerator = argv[i+1];
 #ifdef G4MULTITHREADED
         else if(G4String(argv[i])=="-t") nThreads = G4UIcommand::ConvertToInt(argv[i+1]);
+        else if(G4String(argv[i])=="-r") runManagerType = argv[i+1];
+        else if(G4String(argv[i])=="-e") eventModulo = G4UIcommand::ConvertToInt(argv[i+1]);
+        else if(G4String(argv[i])=="-c") seedOncePerCommunication = G4UIcommand::ConvertToInt(argv[i+1]);
+        else if(G4String(argv[i])=="-n") numaMode = G4UIcommand::ConvertToInt(argv[i+1]);
 #endif
         else if(G4String(argv[i])=="-u") session = argv[i+1];
         else
@@ -109,7 +171,7 @@ int main(int argc, char** argv)
             return 1;
         }
     }
-    if (argc>11) // print usage when there are too many arguments
+    if (argc>29) // print usage when there are too many arguments
     {
         PrintUsage();
         return 1;
@@ -127,32 +189,82 @@ int main(int argc, char** argv)
         else
             ::OUTPUT_FILENAME = "example.out";
     }
+    if(primaryGenerator!="ParticleGun" && primaryGenerator!="GPS" && primaryGenerator!="PhaseSpace")
+    {
+        PrintUsage();
+        return 1;
+    }
 
 
     // --- Choose the Random engine --- //
     G4Random::setTheEngine(new CLHEP::RanecuEngine);
-    G4Random::setTheSeed(time(nullptr));
+    SetMasterSeed(::MASTER_SEED);
+    G4cout << " Master seed: " << ::MASTER_SEED << ", shard index: " << ::SHARD_INDEX << G4endl;
 
     // --- Construct runmanager & Set UserInit --- //
 #ifdef G4MULTITHREADED
+#if G4VERSION_NUMBER >= 1070
+    // Task-based run manager schedules events dynamically (smaller end-of-run tail than fixed chunks)
+    G4RunManagerType runManager_Type;
+    if(runManagerType=="MT") runManager_Type = G4RunManagerType::MT;
+    else if(runManagerType=="Tasking") runManager_Type = G4RunManagerType::Tasking;
+    else if(runManagerType=="Serial") runManager_Type = G4RunManagerType::Serial;
+    else
+    {
+        PrintUsage();
+        return 1;
+    }
+    auto runManager = G4RunManagerFactory::CreateRunManager(runManager_Type);
+#else
+    if(runManagerType!="MT")
+        G4cerr << " Run manager type '" << runManagerType << "' requires Geant4 10.7 or later, MT is used." << G4endl;
     auto runManager = new G4MTRunManager;
+#endif
     runManager->SetNumberOfThreads(nThreads);
+
+    // Events per communication (or task) & seeding granularity
+    auto mtRunManager = dynamic_cast<G4MTRunManager*>(runManager);
+    if(mtRunManager)
+    {
+        if(eventModulo > 0) mtRunManager->SetEventModulo(eventModulo);
+        mtRunManager->SetSeedOncePerCommunication(seedOncePerCommunication);
+    }
+
+    // NUMA: workers pinned per socket, and optionally a replica of the phantom arrays per NUMA node
+    if(numaMode > 0)
+        runManager->SetUserInitialization(new WorkerInitialization(true));
+    NUMAReplicaStore::GetInstance()->SetReplicaEnabled(numaMode > 1);
 #else
     auto runManager = new G4RunManager;
 #endif
-    G4VUserDetectorConstruction* mainDC = new DetectorConstruction(mainPhantom_FilePath.string());
+    G4VUserDetectorConstruction* mainDC = new DetectorConstruction(mainPhantom_FilePath.string(), protQDefinition_FilePath.string());
     runManager->SetUserInitialization(mainDC);
     G4VModularPhysicsList* mainPhys = new PhysicsList;
     runManager->SetUserInitialization(mainPhys);
-    runManager->SetUserInitialization(new ActionInitialization);
+    runManager->SetUserInitialization(new ActionInitialization(primaryGenerator));
     // runManager->Initialize() // commented. It would be in the macro file.
 
     // --- Batch mode or Interactive mode setting --- //
     auto uiManager = G4UImanager::GetUIpointer();
     G4VisManager* visManager = new G4VisExecutive;
     visManager->Initialize();
+    SAFProducer::GetInstance(); // /MRCP/saf/ commands (master)
+    PhaseSpaceWriter::GetInstance(); // /MRCP/phsp/ commands (master)
 
-    if(!macro_FileName.empty()) // macro was provided
+    if(!jobSpool_Path.empty()) // job server mode: initialized once (macro: initialization & common settings)
+    {
+        if(!macro_FileName.empty())
+        {
+            G4String command = "/control/execute ";
+            uiManager->ApplyCommand(command + macro_FileName.string());
+        }
+        else
+            uiManager->ApplyCommand("/run/initialize");
+
+        JobServer jobServer(jobSpool_Path, ::MASTER_SEED);
+        jobServer.Serve();
+    }
+    else if(!macro_FileName.empty()) // macro was provided
     {
         G4String command = "/control/execute ";
         uiManager->ApplyCommand(command + macro_FileName.string());
@@ -0,0 +1,273 @@
+// ********************************************************************
+// * MRCP (Mesh-type Reference Computational Phantom)                 *
+// * Merges the raw tallies ({output}.raw) of runs sharded over       *
+// * processes or nodes (MRCP -s masterSeed -i shardIndex).           *
+// ********************************************************************
+//
+
+#include "RunTally.hh"
+
+#include "G4ios.hh"
+#include "G4SystemOfUnits.hh"
+
+// C++ std lib
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+// --- main() Arguments usage explanation --- //
+namespace
+{
+void PrintUsage()
+{
+    G4cerr << " Usage: " << G4endl
+        << " MRCPMerge [-o outfile] shard1.raw shard2.raw ..." << G4endl;
+    G4cerr << "\t--- Option lists ---"
+        << "\n\t[-o] <Set outfile> default: ""merged.out"", inputtype: string"
+        << "\n\t\t(also writes [OUT].subModel.out and [OUT].raw)"
+        << G4endl;
+}
+
+G4String GetUncertaintyInfo(const RunTallyRecord& record)
+{
+    std::stringstream ss;
+    if(record.batchSize==0)
+        ss << "history-by-history";
+    else if(record.batchSize<0)
+        ss << "batch statistics (a batch per thread, " << record.tally.nSamples << " batches)";
+    else
+        ss << "batch statistics (" << record.batchSize << " events per batch, " << record.tally.nSamples << " batches)";
+    return ss.str();
+}
+
+void PrintDataInRows(std::ostream& out, const RunTallyRecord& record, size_t nShards)
+{
+    out << std::fixed;
+    out << "===========================================================================" << G4endl;
+    out << " Run ID: " << record.runID << G4endl;
+    out << " Number of shards: " << nShards << G4endl;
+    out << " Running time, sum of shards (s): " << record.runTime << G4endl;
+    out << " Number of event processed: " << record.tally.nEvents << G4endl;
+    out << " Uncertainty: " << GetUncertaintyInfo(record) << G4endl;
+    out << " Source: " << record.sourceInfo << G4endl;
+    out << "===========================================================================" << G4endl;
+    out << std::scientific;
+
+    out << std::setw(25) << "Protection Quantity"
+        << std::setw(25) << "Mean dose (Gy or Sv)"
+        << std::setw(25) << "Relative error" << G4endl;
+
+    const auto& tally = record.tally;
+    for(size_t i = 0; i < tally.protQSum.size(); ++i)
+    {
+        G4double meanDose, relativeError;
+        std::tie(meanDose, relativeError) =
+                GetMeanAndRelativeError(tally.protQSum[i], tally.protQSquaredSum[i], tally.nEvents, tally.nSamples);
+
+        out << std::setw(25) << record.protQNames[i]
+            << std::setw(25) << meanDose/gray
+            << std::setw(25) << relativeError << G4endl;
+    }
+
+    out << G4endl << G4endl;
+}
+
+void PrintDataInCols(std::ostream& out, const RunTallyRecord& record, size_t nShards, G4bool printHeader)
+{
+    const auto& tally = record.tally;
+
+    // --- Header --- //
+    if(printHeader)
+    {
+        out << std::fixed
+            << "RunID" << "\t"
+            << "NShards" << "\t"
+            << "RunT(s)" << "\t"
+            << "NEvents" << "\t"
+            << "Source" << "\t";
+
+        for(size_t i = 0; i < tally.protQSum.size(); ++i)
+            out << record.protQNames[i] << "(Gy|Sv)" << "\t"
+                << record.protQNames[i] + "Error" << "\t";
+
+        out << G4endl;
+    }
+
+    // --- Data (a row per source position, if multiple) --- //
+    auto printRow = [&](G4long nEvents, G4long nSamples, const G4String& sourceInfo,
+                        const G4double* protQSum, const G4double* protQSquaredSum)
+    {
+        out.precision(3);
+        out << std::fixed
+            << record.runID << "\t"
+            << nShards << "\t"
+            << record.runTime << "\t"
+            << nEvents << "\t"
+            << sourceInfo << "\t";
+
+        out.precision(6);
+        out << std::scientific;
+        for(size_t i = 0; i < tally.protQSum.size(); ++i)
+        {
+            G4double meanDose, relativeError;
+            std::tie(meanDose, relativeError) =
+                    GetMeanAndRelativeError(protQSum[i], protQSquaredSum[i], nEvents, nSamples);
+
+            out << meanDose/gray << "\t"
+                << relativeError << "\t";
+        }
+
+        out << G4endl;
+    };
+
+    if(record.positionInfos.empty())
+    {
+        printRow(tally.nEvents, tally.nSamples, record.sourceInfo, tally.protQSum.data(), tally.protQSquaredSum.data());
+        return;
+    }
+
+    size_t nProtQ = tally.protQSum.size();
+    std::vector<G4double> zero(nProtQ, 0.);
+    for(size_t i = 0; i < record.positionInfos.size(); ++i)
+    {
+        if(i < tally.GetNumPositions())
+            printRow(tally.positionNEvents[i], tally.positionNSamples[i], record.positionInfos[i],
+                     &tally.positionProtQSum[i * nProtQ], &tally.positionProtQSquaredSum[i * nProtQ]);
+        else // no event from this position
+            printRow(0, 0, record.positionInfos[i], zero.data(), zero.data());
+    }
+}
+
+void PrintSubModelData(std::ostream& out, const RunTallyRecord& record)
+{
+    const auto& tally = record.tally;
+
+    out << std::fixed;
+    out << "===========================================================================" << G4endl;
+    out << " Run ID: " << record.runID << G4endl;
+    out << " Number of event processed: " << tally.nEvents << G4endl;
+    out << " Uncertainty: " << GetUncertaintyInfo(record) << G4endl;
+    out << " Source: " << record.sourceInfo << G4endl;
+    out << " RBM & BS doses by DRF are listed with IDs -10xx & -20xx" << G4endl;
+    out << "===========================================================================" << G4endl;
+
+    out << std::setw(10) << "ID"
+        << std::setw(30) << "SubModel"
+        << std::setw(16) << "Mass (g)"
+        << std::setw(20) << "Mean dose (Gy)"
+        << std::setw(20) << "Relative error" << G4endl;
+
+    for(size_t i = 0; i < tally.subModelDoseSum.size(); ++i)
+    {
+        G4double meanDose, relativeError;
+        std::tie(meanDose, relativeError) =
+                GetMeanAndRelativeError(tally.subModelDoseSum[i], tally.subModelDoseSquaredSum[i],
+                                        tally.nEvents, tally.nSamples);
+
+        out << std::fixed << std::setprecision(3)
+            << std::setw(10) << record.doseTallyIDs[i]
+            << std::setw(30) << record.doseTallyNames[i]
+            << std::setw(16) << record.doseTallyMasses[i]
+            << std::scientific << std::setprecision(6)
+            << std::setw(20) << meanDose/gray
+            << std::setw(20) << relativeError << G4endl;
+    }
+
+    out << G4endl << G4endl;
+}
+}
+
+int main(int argc, char** argv)
+{
+    // --- Parsing main() Arguments --- //
+    std::filesystem::path output_FileName{"merged.out"};
+    std::vector<std::filesystem::path> shard_FileNames;
+    for(G4int i = 1; i<argc; ++i)
+    {
+        if(G4String(argv[i])=="-o" && i+1<argc) output_FileName = argv[++i];
+        else shard_FileNames.push_back(argv[i]);
+    }
+    if(shard_FileNames.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    // --- Read & merge the shards, run by run --- //
+    std::map<G4int, RunTallyRecord> merged_Map; // runID, merged record
+    std::map<G4int, size_t> nShards_Map;
+    std::map< G4int, std::set< std::pair<G4long, G4int> > > seeds_Map; // runID, (master seed, shard index)
+    for(const auto& shard_FileName: shard_FileNames)
+    {
+        std::ifstream ifs(shard_FileName);
+        if(!ifs.is_open())
+        {
+            G4cerr << "Cannot open the raw tally file: " << shard_FileName << G4endl;
+            return 1;
+        }
+
+        RunTallyRecord record;
+        while(ifs >> std::ws, !ifs.eof())
+        {
+            if(!record.Read(ifs))
+            {
+                G4cerr << "Invalid raw tally file: " << shard_FileName << G4endl;
+                return 1;
+            }
+
+            // The same seed & shard index means the same histories
+            if(!seeds_Map[record.runID].insert(std::make_pair(record.masterSeed, record.shardIndex)).second)
+                G4cerr << "Warning: duplicated shard (master seed " << record.masterSeed
+                       << ", shard index " << record.shardIndex << ") of run " << record.runID
+                       << " in " << shard_FileName << G4endl;
+
+            auto merged = merged_Map.find(record.runID);
+            if(merged==merged_Map.end())
+            {
+                merged_Map[record.runID] = record;
+                nShards_Map[record.runID] = 1;
+                continue;
+            }
+
+            if(!merged->second.IsCompatible(record))
+            {
+                G4cerr << "Run " << record.runID << " in " << shard_FileName
+                       << " does not match the other shards (source, statistics, or tallies)" << G4endl;
+                return 1;
+            }
+            merged->second.tally.Add(record.tally);
+            merged->second.runTime += record.runTime;
+            ++nShards_Map[record.runID];
+        }
+    }
+
+    // --- Print the results --- //
+    auto subModelOutput_FileName = output_FileName;
+    subModelOutput_FileName.replace_extension(".subModel.out");
+    auto rawOutput_FileName = output_FileName;
+    rawOutput_FileName.replace_extension(".raw");
+
+    std::ofstream ofs(output_FileName);
+    std::ofstream ofsSubModel(subModelOutput_FileName);
+    std::ofstream ofsRaw(rawOutput_FileName);
+
+    G4bool printHeader = true;
+    for(auto& merged: merged_Map)
+    {
+        auto& record = merged.second;
+        record.shardIndex = -1; // merged
+        size_t nShards = nShards_Map[merged.first];
+
+        PrintDataInRows(G4cout, record, nShards);
+        PrintDataInCols(ofs, record, nShards, printHeader);
+        PrintSubModelData(ofsSubModel, record);
+        record.Write(ofsRaw);
+        printHeader = false;
+    }
+
+    return 0;
+}
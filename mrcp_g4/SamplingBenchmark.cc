@@ -0,0 +1,115 @@
+// ********************************************************************
+// * MRCP (Mesh-type Reference Computational Phantom)                 *
+// * Micro-benchmark of the decay product sampling (RadioNuclide):    *
+// * linear scan of the cumulative probabilities with the particle    *
+// * looked up by name (former method) vs. alias table with the       *
+// * particle definitions resolved in advance.                        *
+// ********************************************************************
+//
+
+#include "PrimarySamplingHelper.hh"
+
+#include "G4ParticleTable.hh"
+#include "G4Gamma.hh"
+#include "G4Electron.hh"
+#include "G4Positron.hh"
+#include "G4Alpha.hh"
+#include "G4Neutron.hh"
+#include "G4Geantino.hh"
+#include "G4Timer.hh"
+#include "G4UIcommand.hh"
+
+// C++ std lib
+#include <iomanip>
+
+// --- main() Arguments usage explanation --- //
+namespace
+{
+void PrintUsage()
+{
+    G4cerr << " Usage: " << G4endl
+        << " SamplingBenchmark [nSamples (default: 10000000)]" << G4endl
+        << "\t(run where nuclides/ is)" << G4endl;
+}
+}
+
+int main(int argc, char** argv)
+{
+    G4long nSamples = 10000000;
+    if(argc>2)
+    {
+        PrintUsage();
+        return 1;
+    }
+    if(argc==2) nSamples = G4UIcommand::ConvertToLongInt(argv[1]);
+
+    // --- Particles of the nuclide data --- //
+    G4Gamma::Definition();
+    G4Electron::Definition();
+    G4Positron::Definition();
+    G4Alpha::Definition();
+    G4Neutron::Definition();
+    G4Geantino::Definition();
+    auto particleTable = G4ParticleTable::GetParticleTable();
+    particleTable->SetReadiness();
+
+    G4cout << std::setw(10) << "Source"
+           << std::setw(10) << "NLines"
+           << std::setw(20) << "Linear+name (ns)"
+           << std::setw(20) << "Alias (ns)"
+           << std::setw(10) << "Speedup"
+           << std::setw(30) << "Mean E, linear/alias (MeV)" << G4endl;
+
+    for(const G4String radioNuclideName: {"Co60p", "Cs137p", "Ir192p"})
+    {
+        auto radioNuclide = CreateRadioNuclide(radioNuclideName);
+        const auto& decayProducts = radioNuclide->GetDecayProducts();
+        const auto& probabilities = radioNuclide->GetDecayProductProbabilities();
+
+        // --- Former method: cumulative probabilities & particle name --- //
+        std::vector<G4double> cumulativeProbabilities;
+        G4double cumulativeProbability = 0.;
+        for(const auto& probability: probabilities)
+            cumulativeProbabilities.push_back(cumulativeProbability += probability);
+        cumulativeProbabilities.back() = 1.;
+
+        // Mean energies of the samples (same distribution, and keeps the loops from being optimized away)
+        G4double linearEnergySum = 0., aliasEnergySum = 0.;
+        G4Timer linearTimer;
+        linearTimer.Start();
+        for(G4long i = 0; i < nSamples; ++i)
+        {
+            G4double rnd = G4UniformRand();
+            size_t j = 0;
+            while(rnd>cumulativeProbabilities[j]) ++j;
+            G4String particleName = decayProducts[j].particle->GetParticleName();
+            if(particleTable->FindParticle(particleName)) linearEnergySum += decayProducts[j].energy;
+        }
+        linearTimer.Stop();
+
+        // --- Alias table --- //
+        G4Timer aliasTimer;
+        aliasTimer.Start();
+        for(G4long i = 0; i < nSamples; ++i)
+        {
+            G4double particleWeight = 1.;
+            const auto decayProduct = radioNuclide->SampleDecayProduct(particleWeight);
+            if(decayProduct.particle) aliasEnergySum += decayProduct.energy;
+        }
+        aliasTimer.Stop();
+
+        G4double linearTime = linearTimer.GetRealElapsed()*s / nSamples / ns;
+        G4double aliasTime = aliasTimer.GetRealElapsed()*s / nSamples / ns;
+        G4cout << std::setw(10) << radioNuclideName
+               << std::setw(10) << decayProducts.size()
+               << std::setw(20) << std::fixed << std::setprecision(2) << linearTime
+               << std::setw(20) << aliasTime
+               << std::setw(10) << linearTime / aliasTime
+               << std::setw(15) << std::setprecision(5) << linearEnergySum / nSamples / MeV
+               << std::setw(15) << aliasEnergySum / nSamples / MeV << G4endl;
+
+        delete radioNuclide;
+    }
+
+    return 0;
+}
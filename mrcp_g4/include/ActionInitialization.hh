@@ -2,15 +2,20 @@
 #define ActionInitialization_hh_
 
 #include "G4VUserActionInitialization.hh"
+#include "globals.hh"
 
 class ActionInitialization: public G4VUserActionInitialization
 {
 public:
-    ActionInitialization();
+    // Primary generator: ParticleGun, GPS, or PhaseSpace (MRCP -g)
+    ActionInitialization(const G4String& primaryGenerator = "ParticleGun");
     virtual ~ActionInitialization();
 
     virtual void BuildForMaster() const;
     virtual void Build() const;
+
+private:
+    G4String fPrimaryGenerator;
 };
 
 #endif
@@ -4,14 +4,16 @@
 #include "G4VUserDetectorConstruction.hh"
 
 #include <filesystem>
+#include <memory>
 
 class G4LogicalVolume;
 class G4VPhysicalVolume;
+class MRCPProtQCalculator;
 
 class DetectorConstruction: public G4VUserDetectorConstruction
 {
 public:
-    DetectorConstruction(G4String mainPhantom_FilePath);
+    DetectorConstruction(G4String mainPhantom_FilePath, G4String protQDefinition_FilePath = "");
     virtual ~DetectorConstruction();
 
     virtual G4VPhysicalVolume* Construct();
@@ -19,7 +21,9 @@ public:
 
 private:
     std::filesystem::path fMainPhantom_FilePath;
+    std::filesystem::path fProtQDefinition_FilePath;
     G4LogicalVolume* fTetLogicalVolume;
+    std::unique_ptr<MRCPProtQCalculator> fProtQCalculator; // replaced by each Construct()
 };
 
 #endif
@@ -0,0 +1,23 @@
+#ifndef EVENTINFORMATION_HH
+#define EVENTINFORMATION_HH
+
+#include "G4VUserEventInformation.hh"
+#include "globals.hh"
+
+// Source information of an event, from the primary generator to Run::RecordEvent()
+class EventInformation: public G4VUserEventInformation
+{
+public:
+    EventInformation(G4int positionIndex);
+    virtual ~EventInformation();
+
+    virtual void Print() const;
+
+    // Index of the source position (Primary_ParticleGun, /gun/addPosition)
+    G4int GetPositionIndex() const { return fPositionIndex; }
+
+private:
+    G4int fPositionIndex;
+};
+
+#endif
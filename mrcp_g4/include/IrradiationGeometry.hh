@@ -0,0 +1,67 @@
+#ifndef IRRADIATIONGEOMETRY_HH
+#define IRRADIATIONGEOMETRY_HH
+
+#include "globals.hh"
+#include "G4ThreeVector.hh"
+#include "Randomize.hh"
+
+#include <vector>
+
+// ICRP 116 standard irradiation geometries (/gun/irradiationGeometry): broad parallel beams
+// AP, PA, LLAT, RLAT, rotational (ROT, around the long axis) and isotropic (ISO).
+// Directions are in the frame of the ICRP reference phantoms (+x to the left, +y to the back, +z up).
+//
+// The source plane, normal to the beam, is sized to the projection of the phantom's convex hull:
+// the directions of ROT & ISO are binned (equal solid angle), and the plane of a bin covers the hull
+// for all directions of the bin (enlarged by the rotation within the bin).
+// The particle weight is the plane area (cm2), so that the mean dose per event is the dose per unit fluence
+// (Gy cm2), averaged over the directions for ROT & ISO.
+class IrradiationGeometry
+{
+public:
+    // Built once per geometry & model, shared read-only by all threads (nullptr if unknown)
+    static const IrradiationGeometry* GetGeometry(const G4String& geometryName, const G4String& tetModelName);
+
+    const G4String& GetName() const { return fName; }
+    G4double GetMeanArea() const { return fMeanArea; }
+
+    // In the frame of the tets (the phantom box)
+    inline void Sample(G4ThreeVector& position, G4ThreeVector& direction, G4double& particleWeight) const;
+
+private:
+    IrradiationGeometry(const G4String& name, const std::vector<G4ThreeVector>& hullNodes,
+                        G4double cosThetaMin, G4double cosThetaMax, G4int nCosTheta,
+                        G4double phiMin, G4double phiMax, G4int nPhi);
+
+    // Beam direction & the axes of the plane
+    static void GetFrame(G4double cosTheta, G4double phi, G4ThreeVector& direction, G4ThreeVector& u, G4ThreeVector& v);
+
+    struct SourcePlane
+    {
+        G4double uMin, uWidth, vMin, vWidth;
+        G4double distance; // upstream of the hull, along the direction
+    };
+
+    G4String fName;
+    G4double fCosThetaMin, fDCosTheta, fPhiMin, fDPhi;
+    G4int fNPhi;
+    std::vector<SourcePlane> fSourcePlane_Vector; // cosTheta bin * nPhi + phi bin
+    G4double fMeanArea;
+};
+
+inline void IrradiationGeometry::Sample(G4ThreeVector& position, G4ThreeVector& direction, G4double& particleWeight) const
+{
+    size_t bin = std::min(static_cast<size_t>(G4UniformRand() * fSourcePlane_Vector.size()), fSourcePlane_Vector.size() - 1);
+    const auto& plane = fSourcePlane_Vector[bin];
+
+    G4ThreeVector u, v;
+    GetFrame(fCosThetaMin + (bin / fNPhi + G4UniformRand()) * fDCosTheta,
+             fPhiMin + (bin % fNPhi + G4UniformRand()) * fDPhi, direction, u, v);
+    position = plane.distance * direction
+             + (plane.uMin + G4UniformRand() * plane.uWidth) * u
+             + (plane.vMin + G4UniformRand() * plane.vWidth) * v;
+
+    particleWeight *= plane.uWidth * plane.vWidth / CLHEP::cm2;
+}
+
+#endif // IRRADIATIONGEOMETRY_HH
@@ -0,0 +1,72 @@
+#ifndef JOBSERVER_HH
+#define JOBSERVER_HH
+
+#include "G4ThreeVector.hh"
+
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <vector>
+
+// A job, one line of key=value pairs, e.g.
+//   output=Ir192_p12.out nuclide=Ir192p position=0,-38.1522,119.0265 events=15000000 seed=1 angleBiasing=PhantomBox
+// position is in cm. seed defaults to the master seed (-s) mixed with the output name,
+// so that jobs differ from each other and a job gives the same result wherever it is queued.
+struct JobDescription
+{
+    G4String output;
+    G4String radioNuclide;
+    G4String angleBiasing;
+    G4ThreeVector position;
+    G4long nEvents = 0;
+    G4long seed = 0;
+
+    G4String file; // spool file (or stdin) & line, for messages
+    G4int line = 0;
+    G4bool succeeded = false;
+
+    G4bool Parse(const G4String& description, G4long defaultSeed);
+};
+
+// Runs many jobs in one initialized application (phantom, physics tables and threads are set up once).
+// Jobs come from a spool directory or, with "-", from stdin.
+//   Spool: *.job files are claimed by renaming them to *.running (so several servers can share a directory),
+//          and renamed to *.done (*.failed if any job failed) when their jobs are finished. The server stops when the file STOP appears.
+//   stdin: a blank line or the end of input closes a batch of jobs. The server stops at the end of input.
+// The jobs of a batch are ordered by source, so that the nuclide & biasing are reconfigured as rarely as possible.
+// The source of a job is the nuclide (or /gun/particle & /gun/energy of the macro) at /gun/position:
+// the positions, volume source & irradiation geometry of the macro are removed.
+class JobServer
+{
+public:
+    JobServer(const std::filesystem::path& spool, G4long defaultSeed);
+    ~JobServer();
+
+    void Serve();
+
+private:
+    void ServeSpool();
+    void ServeStream(std::istream& in);
+    G4bool ReadJobs(std::istream& in, const G4String& origin, G4bool untilBlankLine, std::vector<JobDescription>& jobs);
+
+    void RunJobs(std::vector<JobDescription>& jobs);
+    G4bool RunJob(const JobDescription& job);
+    G4bool Apply(const G4String& command, const JobDescription& job);
+    G4bool CheckRadioNuclide(const JobDescription& job);
+    G4bool CheckOutput(const JobDescription& job);
+
+    std::filesystem::path fSpool;
+    G4long fDefaultSeed;
+    std::map<G4String, G4int> fLineNumber_Map; // lines read per file
+
+    // Current configuration, to skip the commands that would change nothing
+    G4bool fConfigured;
+    G4String fRadioNuclide;
+    G4String fAngleBiasing;
+    G4ThreeVector fPosition;
+
+    G4int fNJobs;
+    G4int fNFailedJobs;
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include "G4NistManager.hh"
 
 #include <vector>
+#include <algorithm>
 
 class MRCPModel: public TETModel
 {
@@ -24,11 +25,18 @@ public:
     G4double GetSubModelRBMMassRatio(G4int subModelID) const;
     G4double GetSubModelBSMassRatio(G4int subModelID) const;
 
+    // --- Dose tally layout (subModels + DRF-based RBM/BS entries) --- //
+    size_t GetNumDoseTallies() const { return doseTallyID_Vector.size(); }
+    G4int GetDoseTallyID(size_t tallyIndex) const { return doseTallyID_Vector.at(tallyIndex); }
+    G4int GetDoseTallyIndex(G4int tallyID) const; // -1 if the ID is not tallied
+    G4String GetDoseTallyName(size_t tallyIndex) const;
+
     virtual void Print() const override;
 
 private:
     void ImportMaterialData(const G4String& materialFilePath);
     void ImportRBMnBSMassRatioData(const G4String& RBMnBSFilePath);
+    void BuildDoseTallyLayout();
 
     // --- MRCPModel data --- //
     G4double fWholeMass;
@@ -42,6 +50,11 @@ private:
     // --- RBM & BS mass ratio data --- //
     std::map<G4int, G4double> subModelRBMMassRatio_Map;
     std::map<G4int, G4double> subModelBSMassRatio_Map;
+
+    // --- Dose tally data --- //
+    std::vector<G4int> doseTallyID_Vector;
+    std::vector<G4int> doseTallyIndex_Vector; // indexed by (tallyID - fMinDoseTallyID)
+    G4int fMinDoseTallyID;
 };
 
 #endif
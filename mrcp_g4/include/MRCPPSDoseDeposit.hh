@@ -7,6 +7,7 @@
 #include "G4SystemOfUnits.hh"
 
 class MRCPModel;
+struct TETModelReplica;
 
 class MRCPPSDoseDeposit: public G4VPrimitiveScorer
 {
@@ -30,6 +31,7 @@ private:
     G4THitsMap<G4double>* fEvtMap;
 
     MRCPModel* fMRCPModel;
+    const TETModelReplica* fReplica; // of the NUMA node of this worker, set at the first step
 
     std::map< G4int, std::vector<G4double> > subModelRBMDRF_Map;
     std::map< G4int, std::vector<G4double> > subModelBSDRF_Map;
@@ -0,0 +1,66 @@
+#ifndef NUMAREPLICA_HH
+#define NUMAREPLICA_HH
+
+#include "TETModel.hh"
+
+#include "G4Material.hh"
+#include "G4Threading.hh"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+// Read-only arrays of a TETModel used at every step (indexed by tetID)
+struct TETModelReplica
+{
+    G4int numaNode{-1}; // -1: shared by all threads
+
+    const G4Tet* const* tets{nullptr};
+    const G4int* subModelIDs{nullptr};
+    G4Material* const* materials{nullptr}; // nullptr: keep the logical volume's material
+
+    // Storage (node replicas own copies, the shared replica refers to the TETModel)
+    std::vector<G4Tet*> tet_Vector;
+    std::vector<G4int> subModelID_Vector;
+    std::vector<G4Material*> material_Vector;
+};
+
+// Replicas of the tracking arrays per NUMA node.
+// The shared replica is built by the master. With replicas enabled, the replica of a node is
+// built by the first worker thread running on it, so that its pages are allocated on that node
+// (first-touch), and workers read only their local replica.
+class NUMAReplicaStore
+{
+public:
+    static NUMAReplicaStore* GetInstance()
+    {
+        static NUMAReplicaStore* fInstance = new NUMAReplicaStore;
+        return fInstance;
+    }
+
+    // --- Settings (main) --- //
+    void SetReplicaEnabled(G4bool enable) { fReplicaEnabled = enable; }
+    G4bool IsReplicaEnabled() const { return fReplicaEnabled; }
+
+    // Replica for the calling thread (master: the shared one)
+    const TETModelReplica* GetLocalReplica(const TETModel* tetModel);
+
+    // --- NUMA topology (Linux sysfs; a single node elsewhere) --- //
+    static G4int GetCurrentNode();
+    static std::vector< std::vector<G4int> > GetNodeCPUs();
+
+    // Pins the worker thread to a core; workers are distributed over the nodes (sockets) in turn
+    static void PinWorkerThread(G4int threadID);
+
+private:
+    NUMAReplicaStore() : fReplicaEnabled(false) {}
+    ~NUMAReplicaStore() {}
+
+    TETModelReplica* BuildSharedReplica(const TETModel* tetModel) const;
+    TETModelReplica* BuildNodeReplica(const TETModelReplica* sharedReplica, G4int numaNode) const;
+
+    G4bool fReplicaEnabled;
+    std::map< std::pair<const TETModel*, G4int>, std::unique_ptr<TETModelReplica> > replica_Map; // (model, node)
+};
+
+#endif
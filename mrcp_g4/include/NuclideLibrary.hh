@@ -0,0 +1,60 @@
+#ifndef NUCLIDELIBRARY_HH
+#define NUCLIDELIBRARY_HH
+
+#include "PrimarySamplingHelper.hh"
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+// Process-wide store of the nuclide data, shared read-only by all threads.
+// Each decay data file is parsed once, and each sampling table (nuclide, radiations of interest,
+// thresholds & daughters) is normalized once. The data are never modified or freed until the end.
+class NuclideLibrary
+{
+public:
+    static NuclideLibrary* GetInstance()
+    {
+        static NuclideLibrary* fInstance = new NuclideLibrary;
+        return fInstance;
+    }
+
+    // *.RAD file exported from DECDATA Program (ICRP107)
+    const RadioNuclide::DecayData* GetDecayData(const G4String& decayDataFilePath);
+
+    // The table of the key, built by buildSamplingTable if it is the first request
+    const RadioNuclide::SamplingTable* GetSamplingTable(const G4String& key,
+        const std::function<RadioNuclide::SamplingTable()>& buildSamplingTable);
+
+    // --- ICRP107 database --- //
+    struct NuclideRecord
+    {
+        std::vector< std::pair<G4String, G4double> > daughters; // radioactive daughters & branching fractions
+        RadioNuclide::DecayData decayData;
+        InverseCDFTable betaSpectrum; // empty if no beta spectrum
+    };
+
+    // ICRP-07.NDX, ICRP-07.RAD & ICRP-07.BET in the directory, or their binary cache (ICRP-07.bin, written there
+    // after the first parse and used while it is newer than the text files). Loaded once, false if failed.
+    G4bool LoadICRP107(const G4String& databasePath);
+    const NuclideRecord* GetICRP107Nuclide(const G4String& nuclideName);
+
+private:
+    NuclideLibrary() {}
+    ~NuclideLibrary() {}
+
+    static RadioNuclide::DecayData ReadDecayData(const G4String& decayDataFilePath);
+
+    static G4bool ReadICRP107Text(const std::filesystem::path& databasePath, std::map<G4String, NuclideRecord>& nuclides);
+    static G4bool ReadICRP107Binary(const std::filesystem::path& cacheFilePath, std::map<G4String, NuclideRecord>& nuclides);
+    static void WriteICRP107Binary(const std::filesystem::path& cacheFilePath, const std::map<G4String, NuclideRecord>& nuclides);
+    G4String fICRP107Path;
+    std::map<G4String, NuclideRecord> fICRP107_Map;
+
+    std::mutex fMutex;
+    std::map< G4String, std::unique_ptr<const RadioNuclide::DecayData> > fDecayData_Map;
+    std::map< G4String, std::unique_ptr<const RadioNuclide::SamplingTable> > fSamplingTable_Map;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef PHASESPACE_HH
+#define PHASESPACE_HH
+
+#include "G4GenericMessenger.hh"
+#include "G4Step.hh"
+#include "G4Threading.hh"
+#include "G4VPhysicalVolume.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// Phase-space file of the particles entering the phantom box, for two-stage simulations:
+// the source-to-body transport (room scatter, shielding) is run once (PhaseSpaceWriter, /MRCP/phsp/),
+// and the recorded particles are replayed as the primaries of many runs (Primary_PhaseSpace, MRCP -g PhaseSpace).
+//
+// Binary file (little endian as written by the host):
+//   header (64 bytes): "MRCP-PHSP-1" (16 bytes), uint64 nRecords, uint64 nHistories (source events of the writing runs),
+//   reserved (32 bytes), then PhaseSpaceRecord x nRecords.
+struct PhaseSpaceRecord
+{
+    int32_t pdgCode;
+    float   energy;       // kinetic energy (MeV)
+    float   position[3];  // in the world (cm)
+    float   direction[3];
+    float   weight;
+};
+static_assert(sizeof(PhaseSpaceRecord)==36, "PhaseSpaceRecord must be packed (36 bytes)");
+
+struct PhaseSpaceHeader
+{
+    char     magic[16];
+    uint64_t nRecords;
+    uint64_t nHistories;
+    char     reserved[32];
+};
+static_assert(sizeof(PhaseSpaceHeader)==64, "PhaseSpaceHeader must be 64 bytes");
+
+// Records the tracks entering the phantom box (PhantomBox) from the world, from TETSteppingAction.
+// Records are buffered per thread and appended to the file in blocks (under a lock),
+// the header is updated at the end of each run by the master.
+class PhaseSpaceWriter
+{
+public:
+    static PhaseSpaceWriter* GetInstance()
+    {
+        static PhaseSpaceWriter* fInstance = new PhaseSpaceWriter;
+        return fInstance;
+    }
+
+    G4bool IsWriting() const { return fWriting.load(std::memory_order_relaxed); }
+
+    // From the stepping action (workers): records the track if it enters the phantom box (first entry only)
+    void Record(const G4Step* step);
+
+    // From RunAction::EndOfRunAction(): the records of the thread (workers, or the master in sequential mode),
+    // and the number of source events (master)
+    void FlushThreadBuffer();
+    void EndOfRun(G4long nEvents);
+
+private:
+    PhaseSpaceWriter();
+    ~PhaseSpaceWriter();
+
+    void Open(const G4String& fileName);
+    void Close();
+    void WriteHeader();
+
+    G4GenericMessenger* fMessenger;
+
+    std::atomic<G4bool> fWriting;
+    G4bool fKillAtEntry;
+    G4String fFileName;
+    std::ofstream fOfs;
+    std::mutex fFileMutex;
+    uint64_t fNRecords, fNHistories;
+
+    // Per thread
+    static G4ThreadLocal std::vector<PhaseSpaceRecord>* fBuffer;
+    static G4ThreadLocal const G4VPhysicalVolume* fPhantomBox;
+    struct RecordedTracks // not killed at entry: only the first entry of a track (event ID, track IDs)
+    {
+        G4int eventID{-1};
+        std::set<G4int> trackID_Set;
+    };
+    static G4ThreadLocal RecordedTracks* fRecordedTracks;
+};
+
+// Read-only memory map of a phase-space file, shared by all threads (mapped once per file & process)
+class PhaseSpaceFile
+{
+public:
+    // nullptr if the file cannot be mapped or is not a phase-space file
+    static const PhaseSpaceFile* Open(const G4String& fileName);
+
+    const PhaseSpaceRecord* GetRecords() const { return fRecords; }
+    uint64_t GetNumRecords() const { return fNRecords; }
+    uint64_t GetNumHistories() const { return fNHistories; }
+
+    ~PhaseSpaceFile();
+
+private:
+    PhaseSpaceFile() : fMap(nullptr), fMapSize(0), fRecords(nullptr), fNRecords(0), fNHistories(0) {}
+
+    void* fMap;
+    size_t fMapSize;
+    const PhaseSpaceRecord* fRecords;
+    uint64_t fNRecords, fNHistories;
+};
+
+#endif
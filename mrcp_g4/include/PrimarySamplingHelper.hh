@@ -6,6 +6,8 @@
 #include "G4LogicalVolume.hh"
 #include "G4VSolid.hh"
 #include "G4SystemOfUnits.hh"
+#include "G4ParticleDefinition.hh"
+#include "Randomize.hh"
 
 #include <list>
 
@@ -15,55 +17,157 @@ G4ThreeVector SampleDirectionFromTo(const G4ThreeVector& referencePoint,
                                     G4double& particleWeight,
                                     G4double margin = 0.);
 
+// Walker's alias method (Vose's construction): O(1) sampling of a discrete distribution
+class AliasTable
+{
+public:
+    AliasTable() {}
+    AliasTable(const std::vector<G4double>& weights); // not necessarily normalized
+
+    size_t GetSize() const { return fProbability.size(); }
+
+    // A uniform random number picks the column and decides between it and its alias
+    inline size_t Sample() const;
+
+private:
+    std::vector<G4double> fProbability;
+    std::vector<size_t> fAlias;
+};
+
+inline size_t AliasTable::Sample() const
+{
+    G4double u = G4UniformRand() * fProbability.size();
+    size_t column = std::min(static_cast<size_t>(u), fProbability.size() - 1);
+    return (u - column < fProbability[column]) ? column : fAlias[column];
+}
+
+// Inverse CDF of a piecewise-linear density, tabulated at equally spaced cumulative probabilities:
+// O(1) sampling of a continuous distribution (e.g. beta spectrum) by linear interpolation of the table
+class InverseCDFTable
+{
+public:
+    InverseCDFTable() {}
+    InverseCDFTable(const std::vector<G4double>& x, const std::vector<G4double>& density, size_t nQuantiles = 1025);
+    InverseCDFTable(const std::vector<G4double>& quantiles) : fQuantiles(quantiles) {} // tabulated before
+
+    const std::vector<G4double>& GetQuantiles() const { return fQuantiles; }
+
+    inline G4double Sample() const;
+
+private:
+    std::vector<G4double> fQuantiles; // x at the cumulative probabilities i/(n-1)
+};
+
+inline G4double InverseCDFTable::Sample() const
+{
+    G4double u = G4UniformRand() * (fQuantiles.size() - 1);
+    size_t i = std::min(static_cast<size_t>(u), fQuantiles.size() - 2);
+    return fQuantiles[i] + (u - i) * (fQuantiles[i+1] - fQuantiles[i]);
+}
+
+// Tabulated energy spectrum (/gun/spectrum): discrete lines and histogram bins (uniform within a bin),
+// picked by an alias table. Text file, a line or bin per row ('#' for comments):
+//   energy probability               (discrete line)
+//   lowerEdge upperEdge probability  (histogram bin; the probability of the bin, not per unit energy)
+//   unit keV                         (energy unit of the following rows, default: MeV)
+class EnergySpectrum
+{
+public:
+    // Loaded once per file, shared read-only by all threads (nullptr if the file is invalid)
+    static const EnergySpectrum* GetSpectrum(const G4String& spectrumFilePath);
+
+    size_t GetNumBins() const { return fLowerEdge_Vector.size(); }
+    G4double GetMeanEnergy() const { return fMeanEnergy; }
+
+    inline G4double Sample() const;
+
+private:
+    EnergySpectrum() : fMeanEnergy(0.) {}
+    G4bool Load(const G4String& spectrumFilePath);
+
+    std::vector<G4double> fLowerEdge_Vector;
+    std::vector<G4double> fWidth_Vector; // 0 for discrete lines
+    AliasTable fAliasTable;
+    G4double fMeanEnergy;
+};
+
+inline G4double EnergySpectrum::Sample() const
+{
+    size_t bin = fAliasTable.Sample();
+    if(fWidth_Vector[bin]==0.) return fLowerEdge_Vector[bin];
+    return fLowerEdge_Vector[bin] + G4UniformRand() * fWidth_Vector[bin];
+}
+
 // Particle & energy sampling
 class RadioNuclide
 {
 /************************************************************
- * WARNING                                                  *
- * USE CAREFULLY WHEN YOU SAMPLE PARTICLES WITH CONTINUOUS  *
- * E SPECTRA, SUCH AS BETA DECAY PARTICLE, NEUTRON, ETC.    *
- * This class is available only for *.RAD file format data. *
- * Energy sampling of particles with continuous E spectra   *
- * is not supported yet.                                    *
- * Future development will enable the use of other data     *
- * files provided by ICRP107.                               *
+ * Decay data: *.RAD file exported from DECDATA (ICRP107),  *
+ * or the ICRP107 database (NuclideLibrary) which includes  *
+ * the beta spectra (*.BET).                                *
+ * Beta particles are sampled from the spectra if they are  *
+ * available, otherwise at the mean energies of *.RAD.      *
+ * Alpha recoil nuclei & fission fragments are not          *
+ * supported (sampled as geantino).                         *
  ***********************************************************/
 public:
     RadioNuclide(G4String name, const G4String& decayDataFilePath, G4double branchingRatio = 1.);
     ~RadioNuclide();
 
+    enum class Radiation;
+    using EnergyYieldData = std::map<G4double, G4double>;
+    using DecayData = std::map<Radiation, EnergyYieldData>;
+
+    // A nuclide of the ICRP107 database (NuclideLibrary::LoadICRP107())
+    RadioNuclide(G4String name, const DecayData* decayData, const InverseCDFTable* betaSpectrum,
+                 G4double branchingRatio = 1.);
+
     G4String GetRadioNuclideName() const { return fRadioNuclideName; }
     G4double GetBranchingRatio() const { return fBranchingRatio; }
 
-    enum class Radiation;
     struct DecayProduct
     {
-        G4String particleName;
-        G4double energy;
+        G4ParticleDefinition* particle;
+        G4double energy; // mean energy if sampled from the spectrum
+        const InverseCDFTable* spectrum; // nullptr for a discrete energy
+    };
+
+    // Decay products (incl. daughters) with their normalized probabilities & alias table.
+    // Immutable & shared by all RadioNuclides of the same setting (NuclideLibrary).
+    struct SamplingTable
+    {
+        std::vector<DecayProduct> decayProducts;
+        std::vector<G4double> probabilities;
+        AliasTable aliasTable;
+        G4double totalYield;
     };
-    using EnergyYieldData = std::map<G4double, G4double>;
-    using DecayData = std::map<Radiation, EnergyYieldData>;
 
-    DecayData GetDecayDataInteresting() { return fDecayDataInteresting; }
+    DecayData GetDecayDataInteresting() const;
 
     void AddRadioactiveDaughter(RadioNuclide* radioNuclide)
-    { fRadioactiveDaughters.push_back(radioNuclide); }
+    { fNormalized = false; fRadioactiveDaughters.push_back(radioNuclide); }
 
 private:
     G4String fRadioNuclideName;
+    G4String fDecayDataKey; // file path, or the ICRP107 nuclide name
     G4double fBranchingRatio;
 
     std::vector<RadioNuclide*> fRadioactiveDaughters;
 
-    DecayData fDecayData;
-    DecayData fDecayDataInteresting;
-    std::vector< std::pair<G4double, DecayProduct> > fNormalizedDecayData_Vector;
+    // A view of the decay data parsed once per process (NuclideLibrary):
+    // radiations of interest and their thresholds only
+    const DecayData* fDecayData;
+    const InverseCDFTable* fBetaSpectrum; // nullptr if none
+    std::map<Radiation, G4double> fInterestingRadiation_Map; // radiation, energy threshold
+    std::map<Radiation, G4double> fYieldThreshold_Map;
 
     void Normalize();
-    G4double fTotalYield;
+    G4String GetSamplingTableKey() const; // the setting, incl. daughters
+    SamplingTable BuildSamplingTable() const;
+    const SamplingTable* fSamplingTable;
     G4bool fNormalized;
 
-    G4String ICode2G4ParticleName(Radiation radiation);
+    static G4String ICode2G4ParticleName(Radiation radiation);
 
 public:
     void AddInterestingRadiation(Radiation radiation);
@@ -71,11 +175,33 @@ public:
     void RemoveInterestingRadiation(Radiation radiation);
     void SetRadiationEnergyThreshold(Radiation radiation, G4double energy);
     void SetRadiationYieldThreshold(Radiation radiation, G4double yield);
-    void ClearInterestingRadiation() { fDecayDataInteresting.clear(); }
+    void ClearInterestingRadiation();
+
+    inline DecayProduct SampleDecayProduct(G4double& particleWeight);
 
-    DecayProduct SampleDecayProduct(G4double& particleWeight);
+    // Normalized decay products (e.g. to compare sampling methods)
+    const std::vector<DecayProduct>& GetDecayProducts() { if(!fNormalized) Normalize(); return fSamplingTable->decayProducts; }
+    const std::vector<G4double>& GetDecayProductProbabilities() { if(!fNormalized) Normalize(); return fSamplingTable->probabilities; }
 };
 
+inline RadioNuclide::DecayProduct RadioNuclide::SampleDecayProduct(G4double& particleWeight)
+{
+    if(!fNormalized) Normalize();
+
+    particleWeight *= fSamplingTable->totalYield;
+
+    DecayProduct decayProduct = fSamplingTable->decayProducts[fSamplingTable->aliasTable.Sample()];
+    if(decayProduct.spectrum)
+        decayProduct.energy = decayProduct.spectrum->Sample();
+    return decayProduct;
+}
+
+// Predefined sources: Co60p, Cs137p (with Ba-137m), Ir192p (photons of *.RAD in nuclides/), or
+// a nuclide of the ICRP107 database if loaded, e.g. I-131 (itself) or Sr-90+ (with its decay chain in equilibrium),
+// with the radiations of radiationTypes (empty for all), nullptr if unknown
+RadioNuclide* CreateRadioNuclide(const G4String& radioNuclideName,
+                                 const std::vector<RadioNuclide::Radiation>& radiationTypes = {});
+
 enum class RadioNuclide::Radiation // ICODE
 {
     Gamma = 1, // gamma rays (G) (including prompt (PG) & delayed gamma (DG) of spontaneous fission)
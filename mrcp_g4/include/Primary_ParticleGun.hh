@@ -2,6 +2,8 @@
 #define Primary_ParticleGun_hh_
 
 #include "PrimarySamplingHelper.hh"
+#include "TETVolumeSampler.hh"
+#include "IrradiationGeometry.hh"
 
 #include "G4VUserPrimaryGeneratorAction.hh"
 #include "G4ParticleGun.hh"
@@ -24,10 +26,25 @@ public:
         std::stringstream ss;
         if(fRadioNuclide)
             ss << fRadioNuclide->GetRadioNuclideName();
-        ss << "@" << fPrimary->GetParticlePosition()/cm << "cm";
+        else if(fPrimary->GetParticleDefinition() && fSpectrum)
+            ss << fPrimary->GetParticleDefinition()->GetParticleName() << "_spectrum(" << fSpectrumName << ")";
+        else if(fPrimary->GetParticleDefinition())
+            ss << fPrimary->GetParticleDefinition()->GetParticleName() << "_" << fPrimary->GetParticleEnergy()/MeV << "MeV";
+        if(fIrradiationGeometry)
+            ss << "@" << fIrradiationGeometry->GetName() << "_perFluence(cm2)";
+        else if(fVolumeSampler)
+            ss << "@" << fSourceVolumeName;
+        else if(fSourcePosition_Vector.empty())
+            ss << "@" << fPrimary->GetParticlePosition()/cm << "cm";
+        else
+            ss << "@" << fSourcePosition_Vector.size() << "positions(" << fPositionSampling << ")";
         return ss.str();
     }
 
+    // --- Multiple source positions (/gun/addPosition) --- //
+    size_t GetNumPositions() const { return (fVolumeSampler || fIrradiationGeometry) ? 0 : fSourcePosition_Vector.size(); }
+    G4String GetPositionInfo(size_t positionIndex) const;
+
 private:
     G4ParticleGun* fPrimary;
     G4GenericMessenger* fMessenger;
@@ -38,6 +55,48 @@ private:
 
     void SetRadioNuclide(const G4String& radioNuclideName);
     G4String fRadioNuclideName;
+
+    // Tabulated energy spectrum of /gun/particle (/gun/spectrum), instead of /gun/energy & the nuclide
+    void SetSpectrum(const G4String& spectrumFilePath);
+    const EnergySpectrum* fSpectrum;
+    G4String fSpectrumName;
+
+    // ICRP107 database (/gun/nuclideDatabase) & the radiations to sample (/gun/radiationTypes, empty for the defaults)
+    void SetNuclideDatabase(const G4String& databasePath);
+    void SetRadiationTypes(const G4String& iCodes);
+    std::vector<RadioNuclide::Radiation> fRadiationTypes;
+
+    // Events are assigned to the positions by event ID, "roundRobin" (interleaved) or "stratified" (consecutive blocks).
+    // The weight of a position multiplies the particle weight (e.g. relative dwell time).
+    struct SourcePosition
+    {
+        G4ThreeVector position;
+        G4double weight;
+    };
+    std::vector<SourcePosition> fSourcePosition_Vector;
+    G4String fPositionSampling;
+
+    void AddPosition(const G4String& args);
+    void ClearPositions() { fSourcePosition_Vector.clear(); }
+    size_t SelectPosition(const G4Event* anEvent) const;
+
+    // Volume source, uniform in an organ (/gun/sourceOrgan) or subModels (/gun/sourceSubModels) of the main phantom.
+    // It replaces the source positions, and the direction is isotropic (no angle biasing).
+    void SetSourceOrgan(const G4String& organName);
+    void SetSourceSubModels(const G4String& subModelIDs);
+    void ClearSourceVolume() { fVolumeSampler = nullptr; fSourceVolumeName = ""; }
+    void SetSourceVolume(const std::set<G4int>& subModelIDs, const G4String& sourceVolumeName);
+    const TETVolumeSampler* fVolumeSampler;
+    G4String fSourceVolumeName;
+
+    // ICRP 116 irradiation geometry (/gun/irradiationGeometry) around the main phantom, per unit fluence.
+    // It replaces /gun/position (ignored, with a warning) & the volume source, and is removed by /gun/addPosition.
+    void SetIrradiationGeometry(const G4String& geometryName);
+    const IrradiationGeometry* fIrradiationGeometry;
+    G4ThreeVector fSampledPosition; // of the last event, to detect /gun/position
+
+    G4RotationMatrix fPhantomRotation; // the phantom box frame in the world
+    G4ThreeVector fPhantomTranslation;
 };
 
 #endif
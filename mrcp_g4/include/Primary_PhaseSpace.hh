@@ -0,0 +1,45 @@
+#ifndef Primary_PhaseSpace_hh_
+#define Primary_PhaseSpace_hh_
+
+#include "PhaseSpace.hh"
+
+#include "G4VUserPrimaryGeneratorAction.hh"
+#include "G4Event.hh"
+#include "G4GenericMessenger.hh"
+#include "G4ParticleDefinition.hh"
+
+#include <map>
+
+// Primaries from a phase-space file (/phsp/file), the second stage of a two-stage simulation.
+// Each thread of each shard (MRCP -i, /phsp/nShards) reads its own partition of the records in order
+// (wrapping around when exhausted),
+// an event per record with the particle recycled (/phsp/recycle) N times at weight / N.
+// The weights are scaled by (records / source histories) of the file,
+// so that the mean dose per event is the dose per source history of the first stage.
+class Primary_PhaseSpace: public G4VUserPrimaryGeneratorAction
+{
+public:
+    Primary_PhaseSpace();
+    virtual ~Primary_PhaseSpace();
+
+    virtual void GeneratePrimaries(G4Event*);
+
+    G4String GetPrimaryInfo() const { return "phsp:" + fFileName; }
+
+private:
+    void SetFileName(const G4String& fileName);
+    void OpenFile();
+    G4ParticleDefinition* FindParticle(G4int pdgCode);
+
+    G4GenericMessenger* fMessenger;
+    G4String fFileName;
+    G4int fNRecycles;
+    G4int fNShards;
+
+    const PhaseSpaceFile* fFile;
+    G4double fWeightScale;
+    uint64_t fPartitionBegin, fPartitionEnd, fCursor;
+    std::map<G4int, G4ParticleDefinition*> fParticle_Map; // PDG code
+};
+
+#endif
@@ -1,29 +1,59 @@
 #ifndef RUN_HH
 #define RUN_HH
 
+#include "TallyAccumulator.hh"
+#include "TallyReducer.hh"
+
 #include "G4Run.hh"
 #include "G4RunManager.hh"
 #include "G4SDManager.hh"
 #include "G4THitsMap.hh"
 
-class MRCPProtQCalculator;
+#include <chrono>
+
+class MRCPModel;
 
 class Run: public G4Run
 {
 public:
-    Run();
+    // batchSize: 0 for history-by-history statistics,
+    //            N for batches of N events, -1 for one batch per thread
+    // The doses are reduced by TallyReducer if it is running, except for the master of MT
+    Run(G4int batchSize = 0, G4bool processesEvents = true);
     virtual ~Run();
 
     virtual void RecordEvent(const G4Event*);
     virtual void Merge(const G4Run*);
 
-    const std::map< G4String, std::pair<G4double, G4double> >& GetProtQ() const { return fProtQ; }
+    G4int GetBatchSize() const { return fBatchSize; }
+
+    // Tally of this run including the unfinished batch
+    RunTally GetTally() const;
+
+    // Source info of each position (Primary_ParticleGun, /gun/addPosition), empty for a single position
+    const std::vector<G4String>& GetPositionInfos() const { return fPositionInfo_Vector; }
+
+    // End-of-run tail from the time of the last event of each thread (master, after merge):
+    // idle time summed over threads (thread*s) & time between the first and the last thread end (s)
+    std::pair<G4double, G4double> GetTailIdleTime() const;
 
 private:
     G4int fPhantomDose_HCID;
 
-    MRCPProtQCalculator* mainPhantomProtQ;
-    std::map< G4String, std::pair<G4double, G4double> > fProtQ;
+    MRCPModel* fMRCPModel;
+
+    // Protection quantities are indexed as MRCPProtQCalculator::GetProtQName(),
+    // subModel (incl. DRF RBM/BS) doses by MRCPModel::GetDoseTallyIndex()
+    TallyAccumulator fAccumulator;
+    TallyReducer::Producer* fProducer; // nullptr: reduced in this thread
+
+    G4int fBatchSize;
+    std::vector<G4String> fPositionInfo_Vector;
+    std::chrono::steady_clock::time_point fLastEventTime;
+    std::vector<std::chrono::steady_clock::time_point> fThreadEndTime_Vector;
+
+    G4int fPublishInterval; // RunMonitor, 0 if inactive
+    G4int fEventsSincePublish;
 };
 
 #endif
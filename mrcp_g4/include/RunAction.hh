@@ -6,6 +6,9 @@
 #include "G4RunManager.hh"
 #include "G4SystemOfUnits.hh"
 #include "G4Timer.hh"
+#include "G4GenericMessenger.hh"
+
+#include "RunTally.hh"
 
 #include <fstream>
 #include <filesystem>
@@ -23,9 +26,41 @@ public:
     virtual void BeginOfRunAction(const G4Run*);
     virtual void EndOfRunAction(const G4Run*);
 
+    // Output files opened and the last results written (checked by JobServer after each command)
+    static G4bool IsOutputGood() { return fOutputGood; }
+
 private:
-    void PrintDataInRows(std::ostream& out, const std::map< G4String, std::pair<G4double, G4double> >& data);
-    void PrintDataInCols(std::ostream& out, const std::map< G4String, std::pair<G4double, G4double> >& data);
+    void PrintDataInRows(std::ostream& out, const RunTally& tally);
+    void PrintDataInCols(std::ostream& out, const RunTally& tally);
+    void PrintSubModelData(std::ostream& out, const RunTally& tally);
+    void WriteRawData(std::ostream& out, const RunTally& tally);
+    void WriteResults(const RunTally& tally); // all of the above & SAFProducer
+    G4String GetUncertaintyInfo(const RunTally& tally) const;
+
+    // Output files ({output}, {output}.subModel.out, {output}.raw), reopened by /MRCP/run/output
+    void OpenOutputFiles();
+    void SetOutput(const G4String& outputFileName);
+
+    // Early termination criteria (RunMonitor)
+    void SetTargetError(const G4String& args);
+    void ClearTargetErrors();
+    void SetTimeLimit(G4double timeLimit);
+    void SetPublishInterval(G4int publishInterval);
+
+    // Checkpoint & restart (RunMonitor)
+    void SetCheckpoint(const G4String& checkpointFileName);
+    void SetCheckpointInterval(G4double checkpointInterval);
+    void Resume(const G4String& checkpointFileName);
+
+    // Snapshots of the intermediate results (RunMonitor)
+    void SetSnapshot(const G4String& snapshotFileName);
+    void SetSnapshotInterval(G4double snapshotInterval);
+
+    // Chained sub-runs for more than 2^31-1 events
+    void BeamOnLong(const G4String& args);
+    void RunChain(G4long nEvents, G4long subRunSize);
+    static constexpr G4long kDefaultSubRunSize = 1000000000;
+    static constexpr G4long kMaxSubRunSize = 2147483647;
 
     G4Timer* fInitTimer;
     G4Timer* fRunTimer;
@@ -33,6 +68,28 @@ private:
     static G4String fPrimaryInfo;
 
     std::ofstream ofs;
+    std::ofstream ofsSubModel;
+    std::ofstream ofsRaw;
+    G4bool fPrintHeader; // of the columns output, once per file
+    static G4bool fOutputGood;
+
+    G4GenericMessenger* fMessenger;
+    G4int fBatchSize;
+    G4String fCheckpointFileName;
+    G4double fCheckpointInterval;
+    static G4String fResumedSourceInfo; // checked by the threads at the beginning of the run
+    G4String fSnapshotFileName;
+    G4double fSnapshotInterval;
+
+    G4double fRunTime; // of the run or, for chained sub-runs, of all sub-runs
+    G4double fEventRate; // of the (last sub-)run
+    G4int fAsyncReduction; // workers per reducer thread, 0 if disabled
+    G4long fChainEventsToBeProcessed; // incl. the current sub-run, 0 if not chained
+    G4int fNChainSubRuns;
+    G4double fChainRunTime;
+
+    std::pair<G4double, G4double> fTailIdleTime; // of the last (sub-)run, see Run::GetTailIdleTime()
+    std::vector<G4String> fPositionInfos; // see Run::GetPositionInfos()
 };
 
 #endif
@@ -0,0 +1,135 @@
+#ifndef RUNMONITOR_HH
+#define RUNMONITOR_HH
+
+#include "RunTally.hh"
+
+#include "G4Threading.hh"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// State of an interrupted run, written periodically by RunMonitor
+struct RunCheckpoint
+{
+    G4String sourceInfo;
+    G4int batchSize{0};
+    G4long nEventsToBeProcessed{0};
+    std::vector<unsigned long> masterEngineState; // at the beginning of the run
+    std::map< G4int, std::vector<unsigned long> > engineStates; // thread ID (-1: sequential)
+    RunTally tally;
+
+    void Write(std::ostream& out) const;
+    G4bool Read(std::istream& in);
+};
+
+// Watches a run while it is being processed.
+// Workers publish their partial tallies every publishInterval events (lock-free), and
+// a master-side thread merges them periodically to check the stopping criteria
+// (target relative errors of protection quantities, wall-clock budget), and
+// to write checkpoints and snapshots. Workers soft-abort their event loops once a stop is requested.
+class RunMonitor
+{
+public:
+    static RunMonitor* GetInstance()
+    {
+        static RunMonitor* fInstance = new RunMonitor;
+        return fInstance;
+    }
+
+    // --- Settings (master, between runs) --- //
+    void SetTargetError(const G4String& protQName, G4double relativeError);
+    void ClearTargetErrors() { fTargetErrors.clear(); }
+    void SetTimeLimit(G4double timeLimit) { fTimeLimit = timeLimit; }
+    void SetPublishInterval(G4int publishInterval) { fPublishInterval = publishInterval; }
+    void SetCheckInterval(G4double checkInterval) { fCheckInterval = checkInterval; }
+    void SetCheckpoint(const G4String& fileName, G4double interval)
+    { fCheckpointFileName = fileName; fCheckpointInterval = interval; }
+    void SetSnapshot(const G4String& fileName, G4double interval)
+    { fSnapshotFileName = fileName; fSnapshotInterval = interval; }
+
+    // Tally of the interrupted run, added to the next run
+    void SetResumedTally(const RunTally& tally) { fResumedTally = tally; }
+    const RunTally& GetResumedTally() const { return fResumedTally; }
+    void ClearResumedTally() { fResumedTally = RunTally(); }
+
+    G4bool IsActive() const
+    { return !fTargetErrors.empty() || fTimeLimit > 0. || !fCheckpointFileName.empty() || !fSnapshotFileName.empty(); }
+    G4int GetPublishInterval() const { return IsActive() ? fPublishInterval : 0; }
+
+    // --- Master side --- //
+    void Start(G4int runID, G4long nEventsToBeProcessed, G4int batchSize);
+    void Stop();
+    G4String GetTerminationInfo() const { return fTerminationInfo; }
+
+    // --- Worker side --- //
+    void SetSourceInfo(const G4String& sourceInfo);
+    void Publish(G4int threadID, const RunTally& tally, const std::vector<unsigned long>& engineState);
+    G4bool IsStopRequested() const { return fStopRequested.load(std::memory_order_relaxed); }
+
+private:
+    RunMonitor();
+    ~RunMonitor() {}
+
+    void MonitorLoop();
+    void CollectPartialTallies();
+    RunTally GetMergedTally() const; // incl. the resumed tally
+    G4bool CheckConvergence(const RunTally& tally);
+    void WriteCheckpoint(const RunTally& mergedTally);
+    void WriteSnapshot(const RunTally& mergedTally, G4double elapsedTime, G4double monitorTime);
+
+    // Settings
+    std::map<G4String, G4double> fTargetErrors; // protQ name, target relative error
+    G4double fTimeLimit; // in seconds, 0 for no limit
+    G4int fPublishInterval; // in events
+    G4double fCheckInterval; // in seconds
+    G4String fCheckpointFileName;
+    G4double fCheckpointInterval; // in seconds
+    G4String fSnapshotFileName;
+    G4double fSnapshotInterval; // in seconds
+
+    // Partial tally of each thread, exchanged through a triple buffer:
+    // the worker fills the back buffer and swaps it with the middle one,
+    // the monitor thread swaps the front buffer with the middle one if it was updated.
+    struct PartialTally
+    {
+        RunTally tally;
+        std::vector<unsigned long> engineState;
+    };
+    struct alignas(64) PublishSlot
+    {
+        PartialTally buffers[3];
+        std::atomic<unsigned> middle{1}; // index | kUpdated
+        unsigned back{0};  // worker only
+        unsigned front{2}; // monitor thread only
+    };
+    static constexpr unsigned kUpdated = 4;
+    std::vector< std::unique_ptr<PublishSlot> > fPublishSlots; // thread ID + 1 (0: sequential)
+    RunTally fResumedTally;
+
+    // Checkpoint & snapshot information of the current run
+    std::mutex fSourceInfoMutex;
+    G4String fSourceInfo;
+    G4int fRunID;
+    G4int fBatchSize;
+    G4long fNEventsToBeProcessed;
+    std::vector<unsigned long> fMasterEngineState;
+
+    // Monitor thread
+    std::thread fMonitorThread;
+    std::mutex fMonitorMutex;
+    std::condition_variable fMonitorCV;
+    G4bool fMonitorRunning;
+    std::chrono::steady_clock::time_point fStartTime;
+    std::chrono::steady_clock::time_point fLastCheckpointTime;
+    std::chrono::steady_clock::time_point fLastSnapshotTime;
+
+    std::atomic<G4bool> fStopRequested;
+    G4String fTerminationInfo;
+};
+
+#endif
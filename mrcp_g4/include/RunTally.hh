@@ -0,0 +1,73 @@
+#ifndef RUNTALLY_HH
+#define RUNTALLY_HH
+
+#include "globals.hh"
+
+#include <iostream>
+#include <vector>
+
+// Raw, mergeable tallies of a run.
+// squaredSum holds the sum of x^2 over histories (history-by-history mode), or
+// the sum of S^2/n over batches of n histories with sum S (batch mode).
+// nSamples is the number of histories or batches accordingly.
+struct RunTally
+{
+    G4long nEvents{0};
+    G4long nSamples{0};
+
+    std::vector<G4double> protQSum;
+    std::vector<G4double> protQSquaredSum;
+    std::vector<G4double> subModelDoseSum;
+    std::vector<G4double> subModelDoseSquaredSum;
+
+    // Protection quantities per source position (Primary_ParticleGun, /gun/addPosition),
+    // laid out as [positionIndex * nProtQ + protQIndex]. Empty for a single position.
+    std::vector<G4long> positionNEvents;
+    std::vector<G4long> positionNSamples;
+    std::vector<G4double> positionProtQSum;
+    std::vector<G4double> positionProtQSquaredSum;
+
+    size_t GetNumPositions() const { return positionNEvents.size(); }
+
+    void Resize(size_t nProtQ, size_t nDoseTallies);
+    void ResizePositions(size_t nPositions); // keeps the tallies of the existing positions
+    void Add(const RunTally& other);
+    void Clear();
+
+    // Raw tallies in text with full precision (checkpoints)
+    void Write(std::ostream& out) const;
+    G4bool Read(std::istream& in);
+};
+
+// Raw tally of a run with what is needed to print its results without the phantom.
+// Written to {output}.raw by each run (shard) and merged exactly by MRCPMerge.
+struct RunTallyRecord
+{
+    G4int runID{0};
+    G4long masterSeed{0};
+    G4int shardIndex{0};
+    G4String sourceInfo;
+    G4int batchSize{0};
+    G4double runTime{0.}; // in seconds
+
+    std::vector<G4String> protQNames;
+    std::vector<G4int> doseTallyIDs;
+    std::vector<G4String> doseTallyNames;
+    std::vector<G4double> doseTallyMasses; // in g
+    std::vector<G4String> positionInfos; // source info per position, if any
+
+    RunTally tally;
+
+    void Write(std::ostream& out) const;
+    G4bool Read(std::istream& in);
+
+    // Same run setting (quantities, tallies, source, statistics) of a different shard
+    G4bool IsCompatible(const RunTallyRecord& other) const;
+};
+
+// Mean and relative error (standard error of the mean / mean) of a tallied quantity,
+// the error -1 (undefined) for less than 2 samples
+std::pair<G4double, G4double> GetMeanAndRelativeError(G4double sum, G4double squaredSum,
+                                                      G4long nEvents, G4long nSamples);
+
+#endif
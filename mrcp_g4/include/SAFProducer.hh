@@ -0,0 +1,75 @@
+#ifndef SAFPRODUCER_HH
+#define SAFPRODUCER_HH
+
+#include "RunTally.hh"
+
+#include "G4GenericMessenger.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <set>
+#include <vector>
+
+// Specific absorbed fractions (SAF, /kg) of all dose tallies (targets) for a set of source regions & energies,
+// run one after another in the initialized application (/MRCP/saf/run): a run per (source, energy),
+// monoenergetic particles (/MRCP/saf/particle) uniform in the source region (Primary_ParticleGun volume source).
+// SAF = mean dose per history / energy, with the relative error of the dose.
+//
+// Binary output (little endian as written by the host):
+//   "MRCP-SAF-1", uint32 nSources, nEnergies, nTargets, particle name,
+//   per source: name, mass (kg, float64), events per energy (int64),
+//   energies (MeV, float64 x nEnergies),
+//   per target: tally ID (int32), name, mass (kg, float64; 0 for DRF-based RBM & BS),
+//   SAF (float32, [source][energy][target]), relative error (float32, same layout; -1 if the run failed).
+//   Strings are uint32 length + characters.
+class SAFProducer
+{
+public:
+    static SAFProducer* GetInstance()
+    {
+        static SAFProducer* fInstance = new SAFProducer;
+        return fInstance;
+    }
+
+    // From RunAction::EndOfRunAction() of the master, for the run of the current (source, energy)
+    void RecordRun(const RunTally& tally);
+
+private:
+    SAFProducer();
+    ~SAFProducer();
+
+    void SetParticle(const G4String& particleName) { fParticleName = particleName; }
+    void SetEventsPerEnergy(const G4String& nEvents);
+    void AddSource(const G4String& args);
+    void SetEnergies(const G4String& args);
+    void SetLogEnergies(const G4String& args);
+    void Clear();
+    void Run(const G4String& outputFileName);
+
+    G4bool Apply(const G4String& command) const;
+    void Write(const G4String& outputFileName) const;
+
+    G4GenericMessenger* fMessenger;
+
+    // --- Setting --- //
+    struct Source
+    {
+        G4String name; // organ of the protection quantity definition, or subModel IDs (e.g. 89,95)
+        G4bool isOrgan;
+        std::set<G4int> subModelIDs;
+        G4double mass;
+        G4long nEventsPerEnergy; // history budget of the region
+    };
+    G4String fParticleName;
+    G4long fEventsPerEnergy;
+    std::vector<Source> fSource_Vector;
+    std::vector<G4double> fEnergy_Vector;
+
+    // --- Results --- //
+    G4bool fRecording;
+    size_t fSourceIndex, fEnergyIndex;
+    std::vector<G4int> fTargetID_Vector;
+    std::vector<G4float> fSAF_Vector; // [source][energy][target]
+    std::vector<G4float> fRelativeError_Vector;
+};
+
+#endif
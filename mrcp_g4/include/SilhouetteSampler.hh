@@ -0,0 +1,60 @@
+#ifndef SILHOUETTESAMPLER_HH
+#define SILHOUETTESAMPLER_HH
+
+#include "G4ThreeVector.hh"
+#include "G4RandomDirection.hh"
+#include "Randomize.hh"
+
+#include <vector>
+
+// Direction sampling to the silhouette of a convex hull seen from a source position (/gun/angleBiasing Silhouette).
+// The hull is projected on the plane normal to the axis (gnomonic projection: its silhouette becomes a convex polygon),
+// and the cone around the axis is divided into cells of equal solid angle (cos theta & phi bins).
+// A direction is sampled uniformly in the cells that may overlap the polygon (tested conservatively),
+// so that all directions to the hull are covered and the weight is exactly the accepted solid angle / 4pi.
+class SilhouetteSampler
+{
+public:
+    SilhouetteSampler(const G4ThreeVector& referencePoint, const std::vector<G4ThreeVector>& hullNodes,
+                      G4int nCosTheta = 64, G4int nPhi = 128);
+
+    // False if the point is not outside the hull (isotropic, without biasing)
+    G4bool IsBiased() const { return !fAcceptedCell_Vector.empty(); }
+    G4double GetAcceptedSolidAngle() const { return fAcceptedCell_Vector.size() * fCellSolidAngle; }
+
+    inline G4ThreeVector Sample(G4double& particleWeight) const;
+
+private:
+    static G4bool IsCellOverlapping(const std::vector< std::pair<G4double, G4double> >& polygon,
+                                    G4double rho1, G4double rho2, G4double phi1, G4double phi2);
+
+    G4ThreeVector fAxis, fU, fV; // orthonormal frame, fAxis to the hull
+    G4double fCosThetaMin;
+    G4double fDCosTheta, fDPhi, fCellSolidAngle;
+    G4int fNPhi;
+    std::vector<G4int> fAcceptedCell_Vector; // cosTheta bin * nPhi + phi bin
+};
+
+inline G4ThreeVector SilhouetteSampler::Sample(G4double& particleWeight) const
+{
+    if(fAcceptedCell_Vector.empty()) return G4RandomDirection();
+
+    particleWeight *= GetAcceptedSolidAngle() / (4 * CLHEP::pi);
+
+    size_t i = std::min(static_cast<size_t>(G4UniformRand() * fAcceptedCell_Vector.size()), fAcceptedCell_Vector.size() - 1);
+    G4int cell = fAcceptedCell_Vector[i];
+    G4double cosTheta = fCosThetaMin + (cell / fNPhi + G4UniformRand()) * fDCosTheta;
+    G4double sinTheta = std::sqrt(std::max(0., 1. - cosTheta * cosTheta));
+    G4double phi = (cell % fNPhi + G4UniformRand()) * fDPhi;
+
+    return sinTheta * std::cos(phi) * fU + sinTheta * std::sin(phi) * fV + cosTheta * fAxis;
+}
+
+// Direction sampling to the silhouette of the TETModel placed in the physical volume (e.g. MainPhantom in PhantomBox).
+// A sampler per source position is kept per thread.
+G4ThreeVector SampleDirectionToSilhouette(const G4ThreeVector& referencePoint,
+                                          const G4String& tetModelName,
+                                          const G4String& physicalVolumeName,
+                                          G4double& particleWeight);
+
+#endif // SILHOUETTESAMPLER_HH
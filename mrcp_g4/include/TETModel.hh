@@ -11,6 +11,7 @@
 
 #include <vector>
 #include <map>
+#include <mutex>
 #include <set>
 #include <fstream>
 #include <sstream>
@@ -35,9 +36,11 @@ public:
 
     // --- Tetrahedron information --- //
     G4Tet* GetTetrahedron(G4int tetID) const { return tet_Vector.at(static_cast<size_t>(tetID)); }
+    const std::vector<G4Tet*>& GetTetVector() const { return tet_Vector; }
+    const std::vector<G4int>& GetTetSubModelIDVector() const { return tetSubModelID_Vector; }
 
     // --- SubModel information --- //
-    G4int GetSubModelID(G4int tetID) const { return tetID_subModelID_Map.at(tetID); }
+    G4int GetSubModelID(G4int tetID) const { return tetSubModelID_Vector[static_cast<size_t>(tetID)]; }
     std::set<G4int> GetSubModelIDSet() const { return subModelID_Set; }
     G4int GetSubModelNumTet(G4int subModelID) const;
     G4double GetSubModelVolume(G4int subModelID) const;
@@ -46,12 +49,17 @@ public:
     // --- Calculation --- //
     G4bool IsInside(const G4ThreeVector pt);
 
+    // Nodes that may be vertices of the convex hull of the model, relative to the bounding box center (as the tets):
+    // all nodes except those strictly inside a polytope inscribed in the hull. Calculated at the first call.
+    const std::vector<G4ThreeVector>& GetHullNodes() const;
+
 private:
     void ImportNodeData(const G4String& nodeFilePath);
     void ImportEleData(const G4String& eleFilePath);
     void ImportColourData(const G4String& colourFilePath);
 
     void CalculateModelDetails();
+    void CalculateHullNodes() const;
 
     // --- TETModel data --- //
     G4String fModelName;
@@ -63,10 +71,12 @@ private:
 
     // --- node data --- //
     std::vector<G4ThreeVector> node_Vector;
+    mutable std::vector<G4ThreeVector> hullNode_Vector;
+    mutable std::once_flag fHullNodeFlag;
 
     // --- ele data --- //
     std::vector<G4Tet*> tet_Vector;
-    std::map<G4int, G4int> tetID_subModelID_Map;
+    std::vector<G4int> tetSubModelID_Vector; // indexed by tetID
 
     // --- colour data --- //
     std::map<G4int, G4Colour> subModelColour_Map;
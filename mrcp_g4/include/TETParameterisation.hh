@@ -10,6 +10,7 @@
 #include <map>
 
 class TETModel;
+struct TETModelReplica;
 
 class TETParameterisation: public G4VPVParameterisation
 {
@@ -26,6 +27,10 @@ public:
 private:
     TETModel* fTETModel;
     std::map<G4int, G4VisAttributes*> subModelVisAttributes_Map;
+
+    // Tets & materials of each tet, resolved at construction (see NUMAReplicaStore).
+    // This parameterisation is shared by all threads; each thread reads the replica of its NUMA node.
+    const TETModelReplica* GetLocalReplica() const;
 };
 
 #endif
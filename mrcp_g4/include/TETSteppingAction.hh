@@ -34,6 +34,7 @@
 #include "G4UserSteppingAction.hh"
 #include "G4Step.hh"
 #include "G4UnitsTable.hh"
+#include "PhaseSpace.hh"
 
 // *********************************************************************
 // With very low probability, because of the internal bug of G4Tet, the
@@ -41,6 +42,8 @@
 // UserSteppingAction class was written to slightly move these stuck
 // particles.
 // -- UserSteppingAction: Slightly move the stuck particles.
+//                        Record the particles entering the phantom box
+//                        when a phase-space file is written (/MRCP/phsp/).
 // *********************************************************************
 
 class TETSteppingAction : public G4UserSteppingAction
@@ -55,6 +58,8 @@ class TETSteppingAction : public G4UserSteppingAction
     G4double kCarTolerance;
     G4int    stepCounter;
     G4bool   checkFlag;
+
+    PhaseSpaceWriter* phaseSpaceWriter;
 };
 
 #endif
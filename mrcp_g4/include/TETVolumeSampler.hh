@@ -0,0 +1,31 @@
+#ifndef TETVOLUMESAMPLER_HH
+#define TETVOLUMESAMPLER_HH
+
+#include "TETModel.hh"
+#include "PrimarySamplingHelper.hh"
+
+#include <set>
+
+// Uniform points in a set of subModels of a TETModel (e.g. an organ as a volume source):
+// a tet by its volume (alias table), then a point in the tet (SampleRndPointInTet())
+class TETVolumeSampler
+{
+public:
+    // Built once per model & subModel set, shared read-only by all threads (nullptr if no tet)
+    static const TETVolumeSampler* GetSampler(const G4String& tetModelName, const std::set<G4int>& subModelIDs);
+
+    size_t GetNumTets() const { return fTet_Vector.size(); }
+    G4double GetVolume() const { return fVolume; }
+
+    // In the frame of the tets (the phantom box)
+    G4ThreeVector Sample() const { return SampleRndPointInTet(fTet_Vector[fAliasTable.Sample()]); }
+
+private:
+    TETVolumeSampler(const TETModel* tetModel, const std::set<G4int>& subModelIDs);
+
+    std::vector<const G4Tet*> fTet_Vector;
+    AliasTable fAliasTable;
+    G4double fVolume;
+};
+
+#endif
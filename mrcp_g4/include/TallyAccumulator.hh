@@ -0,0 +1,77 @@
+#ifndef TALLYACCUMULATOR_HH
+#define TALLYACCUMULATOR_HH
+
+#include "RunTally.hh"
+
+class MRCPProtQCalculator;
+
+// Accumulates the dose tallies of events into a RunTally.
+// Doses are indexed by MRCPModel::GetDoseTallyIndex(), protection quantities by MRCPProtQCalculator.
+class TallyAccumulator
+{
+public:
+    // batchSize: 0 for history-by-history statistics,
+    //            N for batches of N events, -1 for one batch per thread
+    TallyAccumulator(G4int batchSize = 0);
+
+    // Source position of the current event (multiple positions only), before its doses
+    void SetPositionIndex(G4int positionIndex);
+
+    // Dose of the current event
+    inline void AddDose(size_t tallyIndex, G4double dose);
+    void EndOfEvent();
+
+    // Tally of other threads (merge)
+    void Add(const RunTally& tally) { fTally.Add(tally); }
+
+    // Tally including the unfinished batch
+    RunTally GetTally() const;
+
+private:
+    const MRCPProtQCalculator* mainPhantomProtQ;
+
+    RunTally fTally;
+
+    // Dense dose vector of the current event (history mode) or batch (batch mode)
+    struct PendingSample
+    {
+        std::vector<G4double> subModelDose;
+        std::vector<size_t> tallyIndices;
+        std::vector<G4bool> flags;
+        G4long nEvents{0};
+
+        inline void AddDose(size_t tallyIndex, G4double dose);
+        void Clear();
+    };
+    PendingSample fPending;
+    std::vector<G4double> fPendingProtQ;
+
+    // Per source position (samples of the events from each position), grown as positions appear
+    std::vector<PendingSample> fPositionPending_Vector;
+    G4int fPositionIndex; // of the current event, -1 if none
+
+    G4int fBatchSize;
+    G4bool IsSampleComplete(const PendingSample& pending) const
+    { return fBatchSize==0 || pending.nEvents==fBatchSize; }
+    void AddPendingTo(RunTally& tally, std::vector<G4double>& protQ) const;
+    void AddPositionPendingTo(RunTally& tally, size_t positionIndex, std::vector<G4double>& protQ) const;
+};
+
+inline void TallyAccumulator::PendingSample::AddDose(size_t tallyIndex, G4double dose)
+{
+    subModelDose[tallyIndex] += dose;
+    if(!flags[tallyIndex])
+    {
+        flags[tallyIndex] = true;
+        tallyIndices.push_back(tallyIndex);
+    }
+}
+
+inline void TallyAccumulator::AddDose(size_t tallyIndex, G4double dose)
+{
+    fPending.AddDose(tallyIndex, dose);
+    if(fPositionIndex >= 0)
+        fPositionPending_Vector[fPositionIndex].AddDose(tallyIndex, dose);
+}
+
+#endif
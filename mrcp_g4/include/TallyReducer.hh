@@ -0,0 +1,122 @@
+#ifndef TALLYREDUCER_HH
+#define TALLYREDUCER_HH
+
+#include "TallyAccumulator.hh"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Lock-free single-producer single-consumer ring buffer of dose entries
+class DoseRingBuffer
+{
+public:
+    struct Entry
+    {
+        size_t tallyIndex; // kEndOfEvent for the event boundary, kPositionIndex for the source position (dose)
+        G4double dose;
+    };
+    static constexpr size_t kEndOfEvent = static_cast<size_t>(-1);
+    static constexpr size_t kPositionIndex = static_cast<size_t>(-2);
+
+    DoseRingBuffer(size_t capacity); // power of 2
+
+    // Producer: waits while the buffer is full
+    inline void Push(size_t tallyIndex, G4double dose);
+
+    // Consumer: calls consume(entry) for all available entries, returns their number
+    template<typename F> size_t ConsumeAll(F consume);
+
+private:
+    std::vector<Entry> fBuffer;
+    size_t fMask;
+
+    alignas(64) std::atomic<size_t> fHead; // next entry to write (producer)
+    size_t fCachedTail;
+    alignas(64) std::atomic<size_t> fTail; // next entry to read (consumer)
+};
+
+// Asynchronous reduction of the per-event dose tallies.
+// Each worker (producer) pushes its per-event dose entries into its own ring buffer, and
+// a reducer thread per group of workers accumulates them (protection quantities, statistics)
+// in the same order as the worker would, so the tallies are identical to the synchronous ones.
+class TallyReducer
+{
+public:
+    static TallyReducer* GetInstance()
+    {
+        static TallyReducer* fInstance = new TallyReducer;
+        return fInstance;
+    }
+
+    class Producer
+    {
+    public:
+        Producer(G4int threadID, G4int batchSize);
+
+        // Worker side
+        void SetPositionIndex(G4int positionIndex)
+        { if(positionIndex >= 0) fRingBuffer.Push(DoseRingBuffer::kPositionIndex, positionIndex); }
+        void Push(size_t tallyIndex, G4double dose) { fRingBuffer.Push(tallyIndex, dose); }
+        void EndOfEvent() { fRingBuffer.Push(DoseRingBuffer::kEndOfEvent, 0.); ++fNPushedEvents; }
+        RunTally GetReducedTally() const; // waits until all pushed events are reduced
+
+        // Reducer side
+        size_t Reduce();
+
+    private:
+        G4int fThreadID;
+        DoseRingBuffer fRingBuffer;
+        TallyAccumulator fAccumulator;
+        G4long fNPushedEvents; // worker only
+        std::atomic<G4long> fNReducedEvents;
+
+        G4int fEventsSincePublish; // RunMonitor (reducer thread only)
+    };
+
+    // --- Master, between runs --- //
+    // workersPerReducer: 0 to disable
+    void Start(G4int nThreads, G4int workersPerReducer, G4int batchSize);
+    void Stop();
+    G4bool IsRunning() const { return !fReducerThreads.empty(); }
+
+    // --- Worker side --- //
+    Producer* GetProducer(G4int threadID);
+
+private:
+    TallyReducer() : fReducerRunning(false) {}
+    ~TallyReducer() {}
+
+    void ReducerLoop(size_t firstProducer, size_t lastProducer);
+
+    std::vector< std::unique_ptr<Producer> > fProducers; // thread ID + 1 (0: sequential)
+    std::vector<std::thread> fReducerThreads;
+    std::atomic<G4bool> fReducerRunning;
+};
+
+inline void DoseRingBuffer::Push(size_t tallyIndex, G4double dose)
+{
+    size_t head = fHead.load(std::memory_order_relaxed);
+    if(head - fCachedTail > fMask)
+    {
+        // Full: wait for the reducer
+        while(head - (fCachedTail = fTail.load(std::memory_order_acquire)) > fMask)
+            std::this_thread::yield();
+    }
+    fBuffer[head & fMask] = Entry{tallyIndex, dose};
+    fHead.store(head + 1, std::memory_order_release);
+}
+
+template<typename F>
+size_t DoseRingBuffer::ConsumeAll(F consume)
+{
+    size_t tail = fTail.load(std::memory_order_relaxed);
+    size_t head = fHead.load(std::memory_order_acquire);
+    for(size_t i = tail; i != head; ++i)
+        consume(fBuffer[i & fMask]);
+    fTail.store(head, std::memory_order_release);
+    return head - tail;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef WORKERINITIALIZATION_HH
+#define WORKERINITIALIZATION_HH
+
+#include "G4UserWorkerInitialization.hh"
+
+class WorkerInitialization: public G4UserWorkerInitialization
+{
+public:
+    // pinThreads: pin each worker thread to a core, distributing the workers over the NUMA nodes
+    WorkerInitialization(G4bool pinThreads);
+    virtual ~WorkerInitialization();
+
+    virtual void WorkerInitialize() const;
+    virtual void WorkerRunStart() const;
+
+private:
+    G4bool fPinThreads;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#!/bin/bash
+# Scaling benchmark of the run managers (MT: fixed event chunks, Tasking: dynamic scheduling)
+# Usage: ./scaling_benchmark.sh [nEvents] [thread counts...]
+#   e.g. ./scaling_benchmark.sh 2000000 1 2 4 8 16 32 64 128
+#   NUMA=1 (pinned) or NUMA=2 (pinned + phantom replica per NUMA node) for the NUMA comparison
+# Writes scaling_benchmark_numa[NUMA].tsv: RunManager, NThreads, RunT(s), TailIdle(thread*s), Tail(s)
+
+NEVENTS=${1:-1000000}
+shift
+THREADS=${@:-1 2 4 8 16 32 64 128}
+EXE=${EXE:-./MRCP}
+SEED=${SEED:-12345}
+NUMA=${NUMA:-0}
+
+MACRO=scaling_benchmark.in
+cat > ${MACRO} << EOF
+/run/initialize
+/gun/angleBiasing PhantomBox
+/gun/radioNuclide Ir192p
+/gun/position 0 -38.1522 119.0265 cm
+/run/beamOn ${NEVENTS}
+EOF
+
+RESULT=scaling_benchmark_numa${NUMA}.tsv
+echo -e "RunManager\tNThreads\tRunT(s)\tTailIdle(thread*s)\tTail(s)" > ${RESULT}
+
+for RUNMANAGER in MT Tasking; do
+    for NTHREADS in ${THREADS}; do
+        LOG=scaling_benchmark_numa${NUMA}_${RUNMANAGER}_${NTHREADS}.log
+        ${EXE} -m ${MACRO} -o scaling_benchmark_numa${NUMA}_${RUNMANAGER}_${NTHREADS}.out \
+               -t ${NTHREADS} -r ${RUNMANAGER} -s ${SEED} -n ${NUMA} > ${LOG} 2>&1
+
+        RUNTIME=$(grep "Running time (s):" ${LOG} | tail -1 | awk '{print $4}')
+        TAILIDLE=$(grep "Tail idle time" ${LOG} | tail -1 | awk '{print $5}')
+        TAIL=$(grep "Tail idle time" ${LOG} | tail -1 | awk '{print $7}')
+        echo -e "${RUNMANAGER}\t${NTHREADS}\t${RUNTIME}\t${TAILIDLE}\t${TAIL}" | tee -a ${RESULT}
+    done
+done
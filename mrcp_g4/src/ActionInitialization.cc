@@ -2,12 +2,13 @@
 
 #include "Primary_ParticleGun.hh"
 #include "Primary_GPS.hh"
+#include "Primary_PhaseSpace.hh"
 
 #include "RunAction.hh"
 #include "TETSteppingAction.hh"
 
-ActionInitialization::ActionInitialization()
-: G4VUserActionInitialization()
+ActionInitialization::ActionInitialization(const G4String& primaryGenerator)
+: G4VUserActionInitialization(), fPrimaryGenerator(primaryGenerator)
 {}
 
 ActionInitialization::~ActionInitialization()
@@ -20,8 +21,9 @@ void ActionInitialization::BuildForMaster() const
 
 void ActionInitialization::Build() const
 {
-    SetUserAction(new Primary_ParticleGun);
-//    SetUserAction(new Primary_GPS);
+    if(fPrimaryGenerator=="GPS") SetUserAction(new Primary_GPS);
+    else if(fPrimaryGenerator=="PhaseSpace") SetUserAction(new Primary_PhaseSpace);
+    else SetUserAction(new Primary_ParticleGun);
 
     SetUserAction(new RunAction);
     SetUserAction(new TETSteppingAction);
@@ -2,6 +2,7 @@
 #include "TETModelStore.hh"
 #include "TETParameterisation.hh"
 #include "MRCPModel.hh"
+#include "MRCPProtQCalculator.hh"
 #include "MRCPPSDoseDeposit.hh"
 
 #include "G4SystemOfUnits.hh"
@@ -18,8 +19,9 @@
 #include "G4SDManager.hh"
 #include "G4MultiFunctionalDetector.hh"
 
-DetectorConstruction::DetectorConstruction(G4String mainPhantom_FilePath)
-: G4VUserDetectorConstruction(), fMainPhantom_FilePath(mainPhantom_FilePath.c_str())
+DetectorConstruction::DetectorConstruction(G4String mainPhantom_FilePath, G4String protQDefinition_FilePath)
+: G4VUserDetectorConstruction(), fMainPhantom_FilePath(mainPhantom_FilePath.c_str()),
+  fProtQDefinition_FilePath(protQDefinition_FilePath.c_str())
 {}
 
 DetectorConstruction::~DetectorConstruction()
@@ -48,6 +50,11 @@ G4VPhysicalVolume* DetectorConstruction::Construct()
     auto mainPhantomData = new MRCPModel("MainPhantom", nodeFilePath, eleFilePath, materialFilePath, RBMnBSFilePath, colourFilePath);
     mainPhantomData->Print();
 
+    // Protection quantity calculator, shared read-only by the Runs of all threads
+    if(fProtQDefinition_FilePath.empty()) // ICRP 103 definition next to the phantom files
+        fProtQDefinition_FilePath = fMainPhantom_FilePath.parent_path() / "ICRP103.ProtQ";
+    fProtQCalculator.reset(new MRCPProtQCalculator("MainPhantom", fProtQDefinition_FilePath.string()));
+
     // Create phantom box with margin
     // Don't know the specific reason, but the margin will benefit from memory & initialization time.
     G4double phantomBox_Margin = 10.*cm;
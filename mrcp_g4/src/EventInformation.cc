@@ -0,0 +1,13 @@
+#include "EventInformation.hh"
+
+EventInformation::EventInformation(G4int positionIndex)
+: G4VUserEventInformation(), fPositionIndex(positionIndex)
+{}
+
+EventInformation::~EventInformation()
+{}
+
+void EventInformation::Print() const
+{
+    G4cout << " Source position index: " << fPositionIndex << G4endl;
+}
@@ -0,0 +1,104 @@
+#include "IrradiationGeometry.hh"
+#include "TETModelStore.hh"
+
+#include "G4SystemOfUnits.hh"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+const IrradiationGeometry* IrradiationGeometry::GetGeometry(const G4String& geometryName, const G4String& tetModelName)
+{
+    static std::mutex geometryMutex;
+    static std::map< G4String, std::unique_ptr<const IrradiationGeometry> > geometry_Map;
+
+    // Beam directions: cosTheta & phi ranges (bins)
+    const G4double halfPi = CLHEP::halfpi;
+    std::map< G4String, std::tuple<G4double, G4double, G4int, G4double, G4double, G4int> > definition_Map{
+        {"AP",   std::make_tuple(0., 0., 1, halfPi,     halfPi,      1)},   // +y
+        {"PA",   std::make_tuple(0., 0., 1, 3 * halfPi, 3 * halfPi,  1)},   // -y
+        {"LLAT", std::make_tuple(0., 0., 1, CLHEP::pi,  CLHEP::pi,   1)},   // -x, from the left
+        {"RLAT", std::make_tuple(0., 0., 1, 0.,         0.,          1)},   // +x, from the right
+        {"ROT",  std::make_tuple(0., 0., 1, 0.,         CLHEP::twopi, 360)},
+        {"ISO",  std::make_tuple(-1., 1., 64, 0.,       CLHEP::twopi, 128)}};
+    auto definition = definition_Map.find(geometryName);
+    if(definition==definition_Map.end()) return nullptr;
+
+    std::lock_guard<std::mutex> lock(geometryMutex);
+    auto& geometry = geometry_Map[geometryName + " " + tetModelName];
+    if(!geometry)
+    {
+        auto tetModel = TETModelStore::GetInstance()->GetTETModel(tetModelName);
+        if(!tetModel) return nullptr;
+
+        G4double cosThetaMin, cosThetaMax, phiMin, phiMax;
+        G4int nCosTheta, nPhi;
+        std::tie(cosThetaMin, cosThetaMax, nCosTheta, phiMin, phiMax, nPhi) = definition->second;
+        geometry.reset(new IrradiationGeometry(geometryName, tetModel->GetHullNodes(),
+                                               cosThetaMin, cosThetaMax, nCosTheta, phiMin, phiMax, nPhi));
+    }
+    return geometry.get();
+}
+
+IrradiationGeometry::IrradiationGeometry(const G4String& name, const std::vector<G4ThreeVector>& hullNodes,
+                                         G4double cosThetaMin, G4double cosThetaMax, G4int nCosTheta,
+                                         G4double phiMin, G4double phiMax, G4int nPhi)
+: fName(name), fCosThetaMin(cosThetaMin), fDCosTheta((cosThetaMax - cosThetaMin) / nCosTheta),
+  fPhiMin(phiMin), fDPhi((phiMax - phiMin) / nPhi), fNPhi(nPhi), fMeanArea(0.)
+{
+    G4double rMax = 0.;
+    for(const auto& node: hullNodes)
+        rMax = std::max(rMax, node.mag());
+
+    for(G4int i = 0; i < nCosTheta; ++i)
+    {
+        // Largest polar angle from the bin center
+        G4double cosTheta = fCosThetaMin + (i + 0.5) * fDCosTheta;
+        G4double theta = std::acos(cosTheta);
+        G4double halfDTheta = std::max(theta - std::acos(std::min(fCosThetaMin + (i + 1) * fDCosTheta, 1.)),
+                                       std::acos(std::max(fCosThetaMin + i * fDCosTheta, -1.)) - theta);
+
+        for(G4int j = 0; j < nPhi; ++j)
+        {
+            // The frame turns by less than (halfDTheta + halfDPhi) within the bin,
+            // so that the projection of a node moves by less than rMax times that angle
+            G4double margin = 1.*mm + rMax * (halfDTheta + 0.5 * std::abs(fDPhi));
+
+            G4ThreeVector direction, u, v;
+            GetFrame(cosTheta, fPhiMin + (j + 0.5) * fDPhi, direction, u, v);
+
+            G4double sMin(DBL_MAX), uMin(DBL_MAX), uMax(-DBL_MAX), vMin(DBL_MAX), vMax(-DBL_MAX);
+            for(const auto& node: hullNodes)
+            {
+                sMin = std::min(sMin, node.dot(direction));
+                G4double nodeU = node.dot(u), nodeV = node.dot(v);
+                uMin = std::min(uMin, nodeU);
+                uMax = std::max(uMax, nodeU);
+                vMin = std::min(vMin, nodeV);
+                vMax = std::max(vMax, nodeV);
+            }
+
+            SourcePlane plane;
+            plane.uMin = uMin - margin;
+            plane.uWidth = uMax - uMin + 2 * margin;
+            plane.vMin = vMin - margin;
+            plane.vWidth = vMax - vMin + 2 * margin;
+            plane.distance = sMin - margin;
+            fSourcePlane_Vector.push_back(plane);
+            fMeanArea += plane.uWidth * plane.vWidth;
+        }
+    }
+    fMeanArea /= fSourcePlane_Vector.size();
+}
+
+void IrradiationGeometry::GetFrame(G4double cosTheta, G4double phi, G4ThreeVector& direction, G4ThreeVector& u, G4ThreeVector& v)
+{
+    G4double sinTheta = std::sqrt(std::max(0., 1. - cosTheta * cosTheta));
+    G4double cosPhi = std::cos(phi), sinPhi = std::sin(phi);
+
+    direction.set(sinTheta * cosPhi, sinTheta * sinPhi, cosTheta);
+    u.set(cosTheta * cosPhi, cosTheta * sinPhi, -sinTheta);
+    v.set(-sinPhi, cosPhi, 0.);
+}
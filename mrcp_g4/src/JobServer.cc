@@ -0,0 +1,299 @@
+#include "JobServer.hh"
+#include "RunAction.hh"
+#include "PrimarySamplingHelper.hh"
+
+#include "G4UImanager.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+extern void SetMasterSeed(G4long masterSeed); // From main() (MRCP.cc)
+
+namespace
+{
+// FNV-1a, the same on every platform (unlike std::hash)
+uint64_t HashString(const G4String& str)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(unsigned char c: str)
+    {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+}
+
+G4bool JobDescription::Parse(const G4String& description, G4long defaultSeed)
+{
+    G4bool seedGiven = false;
+
+    std::istringstream iss(description);
+    G4String token;
+    while(iss >> token)
+    {
+        auto pos = token.find('=');
+        if(pos==std::string::npos) return false;
+        G4String key = token.substr(0, pos);
+        G4String value = token.substr(pos+1);
+
+        std::istringstream vss(value);
+        if(key=="output") output = value;
+        else if(key=="nuclide") radioNuclide = value;
+        else if(key=="angleBiasing") angleBiasing = value;
+        else if(key=="position")
+        {
+            G4double x, y, z;
+            char comma1, comma2;
+            vss >> x >> comma1 >> y >> comma2 >> z;
+            if(vss.fail() || comma1!=',' || comma2!=',') return false;
+            position = G4ThreeVector(x, y, z)*cm;
+        }
+        else if(key=="events") vss >> nEvents;
+        else if(key=="seed")
+        {
+            vss >> seed;
+            seedGiven = true;
+        }
+        else return false;
+
+        if(vss.fail()) return false;
+    }
+
+    // Jobs without a seed would all replay the same random numbers (mixed further by SetMasterSeed())
+    if(!seedGiven) seed = static_cast<G4long>((static_cast<uint64_t>(defaultSeed) ^ HashString(output)) & 0x7fffffffffffffffULL);
+
+    return !output.empty() && nEvents > 0;
+}
+
+JobServer::JobServer(const std::filesystem::path& spool, G4long defaultSeed)
+: fSpool(spool), fDefaultSeed(defaultSeed), fConfigured(false), fNJobs(0), fNFailedJobs(0)
+{}
+
+JobServer::~JobServer()
+{}
+
+void JobServer::Serve()
+{
+    // The /gun/ commands of the macro (e.g. /gun/nuclideDatabase) are executed by the threads at the next run:
+    // a run of no events executes them now, so that the nuclides of the jobs can be checked here
+    G4UImanager::GetUIpointer()->ApplyCommand("/run/beamOn 0");
+
+    if(fSpool=="-")
+        ServeStream(std::cin);
+    else
+        ServeSpool();
+
+    G4cout << " Job server stops: " << fNJobs << " jobs done, " << fNFailedJobs << " failed" << G4endl;
+}
+
+void JobServer::ServeSpool()
+{
+    if(!std::filesystem::is_directory(fSpool))
+    {
+        G4Exception("JobServer::ServeSpool()", "", FatalException,
+            G4String("      spool directory '" + fSpool.string() + "' does not exist").c_str());
+        return;
+    }
+
+    G4cout << " Job server: waiting for *.job files in '" << fSpool.string()
+           << "' (create '" << (fSpool/"STOP").string() << "' to stop)" << G4endl;
+
+    while(!std::filesystem::exists(fSpool/"STOP"))
+    {
+        // --- Claim the queued job files (a failed rename means another server took it) --- //
+        std::vector<std::filesystem::path> queued_Vector;
+        std::error_code ec;
+        for(const auto& entry: std::filesystem::directory_iterator(fSpool, ec))
+            if(entry.path().extension()==".job") queued_Vector.push_back(entry.path());
+        std::sort(queued_Vector.begin(), queued_Vector.end());
+
+        std::vector<std::filesystem::path> claimed_Vector;
+        for(const auto& queued: queued_Vector)
+        {
+            auto claimed = queued;
+            claimed.replace_extension(".running");
+            std::filesystem::rename(queued, claimed, ec);
+            if(!ec) claimed_Vector.push_back(claimed);
+        }
+
+        if(claimed_Vector.empty())
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+        }
+
+        // --- Run the jobs of all claimed files at once, so that they are ordered together --- //
+        std::vector<JobDescription> jobs;
+        std::map<G4String, G4bool> fileSucceeded_Map;
+        for(const auto& claimed: claimed_Vector)
+        {
+            std::ifstream ifs(claimed);
+            fileSucceeded_Map[claimed.string()] = ReadJobs(ifs, claimed.string(), false, jobs);
+        }
+
+        RunJobs(jobs);
+
+        for(const auto& job: jobs)
+            if(!job.succeeded) fileSucceeded_Map[job.file] = false;
+
+        // --- *.done or *.failed (see the log for the failed jobs) --- //
+        for(const auto& claimed: claimed_Vector)
+        {
+            auto finished = claimed;
+            finished.replace_extension(fileSucceeded_Map[claimed.string()] ? ".done" : ".failed");
+            std::filesystem::rename(claimed, finished, ec);
+        }
+    }
+}
+
+void JobServer::ServeStream(std::istream& in)
+{
+    G4cout << " Job server: reading jobs from stdin (a blank line runs the jobs read so far)" << G4endl;
+
+    while(in.good())
+    {
+        std::vector<JobDescription> jobs;
+        ReadJobs(in, "stdin", true, jobs);
+        RunJobs(jobs);
+    }
+}
+
+G4bool JobServer::ReadJobs(std::istream& in, const G4String& origin, G4bool untilBlankLine,
+                           std::vector<JobDescription>& jobs)
+{
+    G4bool succeeded = true;
+    G4String line;
+    while(std::getline(in, line))
+    {
+        ++fLineNumber_Map[origin];
+        auto first = line.find_first_not_of(" \t\r");
+        if(first==std::string::npos)
+        {
+            if(untilBlankLine) break;
+            continue;
+        }
+        if(line[first]=='#') continue;
+
+        JobDescription job;
+        job.file = origin;
+        job.line = fLineNumber_Map[origin];
+        if(!job.Parse(line, fDefaultSeed))
+        {
+            G4Exception("JobServer::ReadJobs()", "", JustWarning,
+                G4String("      invalid job at " + origin + ":" + std::to_string(job.line) + ": " + line).c_str());
+            ++fNFailedJobs;
+            succeeded = false;
+            continue;
+        }
+        jobs.push_back(job);
+    }
+
+    return succeeded;
+}
+
+void JobServer::RunJobs(std::vector<JobDescription>& jobs)
+{
+    // The current source first, then grouped by nuclide, biasing & position (in the order of submission otherwise)
+    std::stable_sort(jobs.begin(), jobs.end(),
+        [this](const JobDescription& a, const JobDescription& b)
+        {
+            return std::make_tuple(a.radioNuclide!=fRadioNuclide, a.radioNuclide, a.angleBiasing,
+                                   a.position.x(), a.position.y(), a.position.z())
+                 < std::make_tuple(b.radioNuclide!=fRadioNuclide, b.radioNuclide, b.angleBiasing,
+                                   b.position.x(), b.position.y(), b.position.z());
+        });
+
+    for(auto& job: jobs)
+    {
+        job.succeeded = RunJob(job);
+        if(job.succeeded) ++fNJobs;
+        else ++fNFailedJobs;
+    }
+}
+
+G4bool JobServer::RunJob(const JobDescription& job)
+{
+    G4cout << " Job " << job.file << ":" << job.line << " -> " << job.output << G4endl;
+
+    // --- Source (only what changed; a failed command leaves the configuration unknown) --- //
+    // The /gun/ commands are executed by the threads at the run, so that a command accepted here may still fail there:
+    // what the threads could reject is checked here, and the sources that would override /gun/position are removed.
+    if(!fConfigured)
+    {
+        if(!Apply("/gun/clearPositions", job) || !Apply("/gun/clearSourceVolume", job) ||
+           !Apply("/gun/irradiationGeometry", job)) return false;
+    }
+    if(!fConfigured || job.radioNuclide!=fRadioNuclide)
+    {
+        fConfigured = false;
+        if(!CheckRadioNuclide(job) || !Apply("/gun/radioNuclide " + job.radioNuclide, job)) return false;
+        fRadioNuclide = job.radioNuclide;
+    }
+    if(!fConfigured || job.angleBiasing!=fAngleBiasing)
+    {
+        fConfigured = false;
+        if(!Apply("/gun/angleBiasing " + job.angleBiasing, job)) return false;
+        fAngleBiasing = job.angleBiasing;
+    }
+    if(!fConfigured || job.position!=fPosition)
+    {
+        fConfigured = false;
+        std::ostringstream oss;
+        oss.precision(std::numeric_limits<G4double>::max_digits10);
+        oss << "/gun/position " << job.position.x()/cm << " " << job.position.y()/cm << " " << job.position.z()/cm << " cm";
+        if(!Apply(oss.str(), job)) return false;
+        fPosition = job.position;
+    }
+    fConfigured = true;
+
+    // --- Output & seed of this job --- //
+    if(!Apply("/MRCP/run/output " + job.output, job) || !CheckOutput(job)) return false;
+    SetMasterSeed(job.seed);
+
+    // --- Run --- //
+    G4bool succeeded = (job.nEvents > 2147483647) ? Apply("/MRCP/run/beamOnLong " + std::to_string(job.nEvents), job)
+                                                  : Apply("/run/beamOn " + std::to_string(job.nEvents), job);
+    return succeeded && CheckOutput(job);
+}
+
+G4bool JobServer::CheckRadioNuclide(const JobDescription& job)
+{
+    // An unknown nuclide only warns in the threads, which would keep the previous source
+    if(job.radioNuclide.empty()) return true;
+    std::unique_ptr<RadioNuclide> radioNuclide(CreateRadioNuclide(job.radioNuclide));
+    if(radioNuclide) return true;
+
+    G4Exception("JobServer::CheckRadioNuclide()", "", JustWarning,
+        G4String("      job at " + job.file + ":" + std::to_string(job.line) + " failed: unknown radionuclide '"
+                 + job.radioNuclide + "' (not predefined, nor in the nuclide database)").c_str());
+    return false;
+}
+
+G4bool JobServer::CheckOutput(const JobDescription& job)
+{
+    // The output command only warns, and the results are written at the end of the run
+    if(RunAction::IsOutputGood()) return true;
+
+    G4Exception("JobServer::CheckOutput()", "", JustWarning,
+        G4String("      job at " + job.file + ":" + std::to_string(job.line) + " failed: cannot write " + job.output).c_str());
+    return false;
+}
+
+G4bool JobServer::Apply(const G4String& command, const JobDescription& job)
+{
+    if(G4UImanager::GetUIpointer()->ApplyCommand(command)==0) return true;
+
+    G4Exception("JobServer::Apply()", "", JustWarning,
+        G4String("      job at " + job.file + ":" + std::to_string(job.line) + " failed: " + command).c_str());
+    return false;
+}
@@ -4,7 +4,7 @@ MRCPModel::MRCPModel(G4String name,
     const G4String& nodeFilePath, const G4String& eleFilePath,
     const G4String& materialFilePath, const G4String& RBMnBSFilePath,
     const G4String& colourFilePath)
-: TETModel(name, nodeFilePath, eleFilePath, colourFilePath), fWholeMass(0.)
+: TETModel(name, nodeFilePath, eleFilePath, colourFilePath), fWholeMass(0.), fMinDoseTallyID(0)
 {
     ImportMaterialData(materialFilePath);
     ImportRBMnBSMassRatioData(RBMnBSFilePath);
@@ -16,6 +16,8 @@ MRCPModel::MRCPModel(G4String name,
             GetSubModelVolume(subModelID) * GetSubModelMaterial(subModelID)->GetDensity();
         fWholeMass += subModelMass_Map.at(subModelID);
     }
+
+    BuildDoseTallyLayout();
 }
 
 MRCPModel::~MRCPModel()
@@ -53,6 +55,27 @@ G4double MRCPModel::GetSubModelBSMassRatio(G4int subModelID) const
         return subModelBSMassRatio_Map.at(subModelID);
 }
 
+G4int MRCPModel::GetDoseTallyIndex(G4int tallyID) const
+{
+    G4int offset = tallyID - fMinDoseTallyID;
+    if(offset < 0 || offset >= static_cast<G4int>(doseTallyIndex_Vector.size()))
+        return -1;
+    else
+        return doseTallyIndex_Vector[static_cast<size_t>(offset)];
+}
+
+G4String MRCPModel::GetDoseTallyName(size_t tallyIndex) const
+{
+    G4int tallyID = GetDoseTallyID(tallyIndex);
+
+    // RBM & BS doses by DRF are stored at -10xx & -20xx (see MRCPPSDoseDeposit::ProcessHits())
+    if(tallyID <= -2000)
+        return GetSubModelMaterial(-(tallyID + 2000))->GetName() + "_BS(DRF)";
+    if(tallyID <= -1000)
+        return GetSubModelMaterial(-(tallyID + 1000))->GetName() + "_RBM(DRF)";
+    return GetSubModelMaterial(tallyID)->GetName();
+}
+
 void MRCPModel::ImportMaterialData(const G4String& materialFilePath)
 {
     // --- Open material file --- //
@@ -147,6 +170,24 @@ void MRCPModel::ImportRBMnBSMassRatioData(const G4String& RBMnBSFilePath)
     ifs.close();
 }
 
+void MRCPModel::BuildDoseTallyLayout()
+{
+    // subModel doses first, then DRF-based RBM (-10xx) & BS (-20xx) doses of bone subModels
+    for(const auto& subModelID: GetSubModelIDSet())
+        doseTallyID_Vector.push_back(subModelID);
+    for(const auto& subModelRBMMassRatio: subModelRBMMassRatio_Map)
+        doseTallyID_Vector.push_back((-subModelRBMMassRatio.first)-1000);
+    for(const auto& subModelBSMassRatio: subModelBSMassRatio_Map)
+        doseTallyID_Vector.push_back((-subModelBSMassRatio.first)-2000);
+
+    // Dense ID -> index table for O(1) lookup
+    auto minmax = std::minmax_element(doseTallyID_Vector.begin(), doseTallyID_Vector.end());
+    fMinDoseTallyID = *minmax.first;
+    doseTallyIndex_Vector.assign(static_cast<size_t>(*minmax.second - *minmax.first + 1), -1);
+    for(size_t i = 0; i < doseTallyID_Vector.size(); ++i)
+        doseTallyIndex_Vector[static_cast<size_t>(doseTallyID_Vector[i] - fMinDoseTallyID)] = static_cast<G4int>(i);
+}
+
 void MRCPModel::Print() const
 {
     // --- Print the overall information for each subModel --- //
@@ -1,10 +1,11 @@
 #include "MRCPPSDoseDeposit.hh"
 #include "TETModelStore.hh"
 #include "MRCPModel.hh"
+#include "NUMAReplica.hh"
 #include "G4Gamma.hh"
 
 MRCPPSDoseDeposit::MRCPPSDoseDeposit(G4String name, G4String phantomName)
-: G4VPrimitiveScorer(name), fHCID(-1), fEvtMap(nullptr), fDRFFlag(false)
+: G4VPrimitiveScorer(name), fHCID(-1), fEvtMap(nullptr), fReplica(nullptr), fDRFFlag(false)
 {
     fMRCPModel = dynamic_cast<MRCPModel*>(
         TETModelStore::GetInstance()->GetTETModel(phantomName)
@@ -64,8 +65,10 @@ void MRCPPSDoseDeposit::Initialize(G4HCofThisEvent* HCE)
 
 G4int MRCPPSDoseDeposit::GetIndex(G4Step* aStep)
 {
+    if(!fReplica) fReplica = NUMAReplicaStore::GetInstance()->GetLocalReplica(fMRCPModel);
+
     G4int copyNo = aStep->GetPreStepPoint()->GetTouchable()->GetCopyNumber();
-    return fMRCPModel->GetSubModelID(copyNo);
+    return fReplica->subModelIDs[copyNo];
 }
 
 void MRCPPSDoseDeposit::ImportBoneDRFData(const G4String& boneDRFFilePath)
@@ -1,525 +1,332 @@
 #include "MRCPProtQCalculator.hh"
 #include "MRCPModel.hh"
 
-MRCPProtQCalculator::MRCPProtQCalculator(const G4String& phantomName)
+namespace
+{
+std::map<G4String, MRCPProtQCalculator*>& CalculatorStore()
+{
+    static std::map<G4String, MRCPProtQCalculator*> calculatorStore;
+    return calculatorStore;
+}
+
+G4bool ParseDouble(const G4String& value, G4double& result)
+{
+    std::istringstream iss(value);
+    iss >> result;
+    return !iss.fail() && iss.eof();
+}
+}
+
+MRCPProtQCalculator::MRCPProtQCalculator(const G4String& phantomName, const G4String& definitionFilePath)
 {
     fMRCPModel = dynamic_cast<MRCPModel*>(TETModelStore::GetInstance()->GetTETModel(phantomName));
     if(!fMRCPModel)
         G4Exception("MRCPProtQCalculator::MRCPProtQCalculator()", "", FatalErrorInArgument,
                 G4String("      invalid MRCPModel '" + phantomName + "'" ).c_str());
 
-    // Protection quantity preset
-    Preset_WholeBodyDose();
-    Preset_OrganDose();
+    // Load organ & tally definitions and compile them
+    ImportDefinitionData(definitionFilePath);
+    CompileWeightMatrix();
+
+    CalculatorStore()[phantomName] = this;
 }
 
-G4double MRCPProtQCalculator::GetOrganDose(Organ organName, const G4THitsMap<G4double>* subModelDoseMap)
+MRCPProtQCalculator::~MRCPProtQCalculator()
 {
-    G4double organDose{0.};
-    for(const auto& datum: *(subModelDoseMap->GetMap()))
+    auto& calculatorStore = CalculatorStore();
+    for(auto calculator = calculatorStore.begin(); calculator != calculatorStore.end(); )
     {
-        // If the subModel is not a part of the organ, skip it.
-        G4int subModelID = datum.first;
-        if(protQ_subModelWeights_Map[organName].find(subModelID) ==
-                protQ_subModelWeights_Map[organName].end())
-            continue;
-
-        // Calculate
-        G4double subModelDose = *datum.second;
-        G4double subModelWeightFactor =
-                protQ_subModelWeights_Map.at(organName).at(subModelID);
-
-        organDose += subModelDose * subModelWeightFactor;
+        if(calculator->second == this) calculator = calculatorStore.erase(calculator);
+        else ++calculator;
     }
-
-    return organDose;
 }
 
-G4double MRCPProtQCalculator::GetWholebodyDose(const G4THitsMap<G4double>* subModelDoseMap)
+const MRCPProtQCalculator* MRCPProtQCalculator::GetCalculator(const G4String& phantomName)
 {
-    return GetOrganDose(Organ::WholeBody, subModelDoseMap);
+    auto& calculatorStore = CalculatorStore();
+    if(calculatorStore.find(phantomName) == calculatorStore.end())
+    {
+        G4Exception("MRCPProtQCalculator::GetCalculator()", "", FatalErrorInArgument,
+                G4String("      No MRCPProtQCalculator exists for '" + phantomName + "'" ).c_str());
+        return nullptr;
+    }
+    return calculatorStore.at(phantomName);
 }
 
-G4double MRCPProtQCalculator::GetEffectiveDose(const G4THitsMap<G4double>* subModelDoseMap)
+void MRCPProtQCalculator::Evaluate(const G4double* subModelDose, G4double* protQ) const
 {
-    // Remainder dose
-    G4double remainderDose = (
-                GetOrganDose(Organ::Adrenals, subModelDoseMap) +
-                GetOrganDose(Organ::Extrathoracic, subModelDoseMap) +
-                GetOrganDose(Organ::GallBladder, subModelDoseMap) +
-                GetOrganDose(Organ::Heart, subModelDoseMap) +
-                GetOrganDose(Organ::Kidneys, subModelDoseMap) +
-                GetOrganDose(Organ::LymphaticNodes, subModelDoseMap) +
-                GetOrganDose(Organ::Muscle, subModelDoseMap) +
-                GetOrganDose(Organ::OralMucosa, subModelDoseMap) +
-                GetOrganDose(Organ::Pancreas, subModelDoseMap) +
-                GetOrganDose(Organ::ProstateUterus, subModelDoseMap) +
-                GetOrganDose(Organ::SmallIntestine, subModelDoseMap) +
-                GetOrganDose(Organ::Spleen, subModelDoseMap) +
-                GetOrganDose(Organ::Thymus, subModelDoseMap)
-                ) / 13.;
-
-    G4double effectiveDose =
-            (
-                GetOrganDose(Organ::RedBoneMarrow, subModelDoseMap) +
-                GetOrganDose(Organ::Colon, subModelDoseMap) +
-                GetOrganDose(Organ::Lungs, subModelDoseMap) +
-                GetOrganDose(Organ::Stomach, subModelDoseMap) +
-                GetOrganDose(Organ::Breast, subModelDoseMap) +
-                remainderDose
-            ) * .12
-            +
-            (
-                GetOrganDose(Organ::Gonads, subModelDoseMap)
-            ) * .08
-            +
-            (
-                GetOrganDose(Organ::Bladder, subModelDoseMap) +
-                GetOrganDose(Organ::Liver, subModelDoseMap) +
-                GetOrganDose(Organ::Oesophagus, subModelDoseMap) +
-                GetOrganDose(Organ::Thyroid, subModelDoseMap)
-            ) * .04
-            +
-            (
-                GetOrganDose(Organ::BoneSurface, subModelDoseMap) +
-                GetOrganDose(Organ::Brain, subModelDoseMap) +
-                GetOrganDose(Organ::SalivaryGlands, subModelDoseMap) +
-                GetOrganDose(Organ::Skin, subModelDoseMap)
-            ) * .01;
-
-    return effectiveDose;
+    for(size_t row = 0; row < protQName_Vector.size(); ++row)
+    {
+        G4double protQValue{0.};
+        for(size_t k = rowOffset_Vector[row]; k < rowOffset_Vector[row + 1]; ++k)
+            protQValue += weight_Vector[k] * subModelDose[colIndex_Vector[k]];
+        protQ[row] = protQValue;
+    }
 }
 
-void MRCPProtQCalculator::Preset_WholeBodyDose()
+const std::map<G4int, G4double>& MRCPProtQCalculator::GetOrganWeights(const G4String& organName) const
 {
-    std::vector<SubModel> wholeBody_subModelVec;
+    if(!HasOrgan(organName))
+        G4Exception("MRCPProtQCalculator::GetOrganWeights()", "", FatalErrorInArgument,
+                G4String("      No organ '" + organName + "' is defined" ).c_str());
+    return organWeights_Map.at(organName);
+}
 
-    for(G4int i = static_cast<G4int>(SubModel::FIRST);
-            i <= static_cast<G4int>(SubModel::LAST); ++i)
-    {
-        SubModel subModel = static_cast<SubModel>(i);
-        switch(subModel)
-        {
-        // not to be included to whole body dose calculation
-        case SubModel::mTongueUpper_food:
-        case SubModel::mOesophagusC:
-        case SubModel::mStomachC:
-        case SubModel::mSIContent__500_0:
-        case SubModel::mSIContent_center__500:
-        case SubModel::mAscColon_content:
-        case SubModel::mTransColonR_content:
-        case SubModel::mTransColonL_content:
-        case SubModel::mDscColon_content:
-        case SubModel::mSigColonW_content:
-        case SubModel::mGallbladderC:
-//        case SubModel::mHeartC: // Blood. included in whole body dose
-        case SubModel::mUrinarybladderC:
-        case SubModel::mET2__15_0: // ICRP 66 Fig. 4. Mucus layer
-        case SubModel::mBB_gen1_m11_m6: // ICRP 66 Fig. 5. Cilia & sol layer
-        case SubModel::mBB_gen1_m6_0: // ICRP 66 Fig. 5. Mucus layer
-            break;
-
-        // else will be included.
-        default:
-            wholeBody_subModelVec.push_back(subModel);
-        }
+std::set<G4int> MRCPProtQCalculator::GetOrganSubModelIDs(const G4String& organName) const
+{
+    // DRF-based RBM & BS doses are tallied at -10xx & -20xx of the subModel xx
+    std::set<G4int> subModelIDs;
+    for(const auto& organWeight: GetOrganWeights(organName))
+    {
+        G4int tallyID = organWeight.first;
+        if(tallyID <= -2000) subModelIDs.insert(-tallyID - 2000);
+        else if(tallyID <= -1000) subModelIDs.insert(-tallyID - 1000);
+        else if(tallyID > 0) subModelIDs.insert(tallyID);
     }
+    return subModelIDs;
+}
 
-    // Calculate mass of the whole body
-    G4double wholeBodyMass{0.};
-    for(const auto& subModel: wholeBody_subModelVec)
+void MRCPProtQCalculator::ImportDefinitionData(const G4String& definitionFilePath)
+{
+    // --- Open protection quantity definition file (.ProtQ) --- //
+    std::ifstream ifs(definitionFilePath.c_str());
+    if(!ifs.is_open()) // Fail to open
     {
-        G4int subModelID = static_cast<G4int>(subModel);
-        G4double subModelMass = fMRCPModel->GetSubModelMass(subModelID);
-
-        wholeBodyMass += subModelMass;
+        G4Exception("MRCPProtQCalculator::ImportDefinitionData()", "", FatalErrorInArgument,
+            G4String("      There is no file '" + definitionFilePath + "'").c_str());
+        return;
     }
 
-    // Calculate & record mass ratio (weight factor) of each subModel
-    for(const auto& subModel: wholeBody_subModelVec)
-    {
-        G4int subModelID = static_cast<G4int>(subModel);
-        G4double subModelMass = fMRCPModel->GetSubModelMass(subModelID);
-
-        protQ_subModelWeights_Map[Organ::WholeBody][subModelID] = subModelMass / wholeBodyMass;
+    G4cout << "  Opening protection quantity definition file '" << definitionFilePath << "'" <<G4endl;
+
+    // --- Get data --- //
+    G4String thisLine;
+    G4int lineNumber = 0;
+    while(std::getline(ifs, thisLine))
+    {
+        ++lineNumber;
+        G4String where = definitionFilePath + ":" + std::to_string(lineNumber);
+
+        // Split the line except comments
+        std::stringstream ss(thisLine.substr(0, thisLine.find('#')));
+        std::vector<G4String> tokens;
+        G4String token;
+        while(ss >> token) tokens.push_back(token);
+        if(tokens.empty()) continue;
+
+        const G4String& keyword = tokens.at(0);
+        if(keyword == "organ" && tokens.size() >= 4)
+            AddOrgan(tokens.at(1), tokens.at(2), {tokens.begin() + 3, tokens.end()}, where);
+        else if(keyword == "wholebody" && tokens.size() >= 3 && tokens.at(2) == "exclude")
+            AddWholeBody(tokens.at(1), {tokens.begin() + 3, tokens.end()}, where);
+        else if(keyword == "combine" && tokens.size() >= 4)
+            AddCombination(tokens.at(1), {tokens.begin() + 2, tokens.end()}, where);
+        else if(keyword == "tissue" && tokens.size() == 3)
+        {
+            G4double tissueWeight;
+            if(!ParseDouble(tokens.at(2), tissueWeight))
+                G4Exception("MRCPProtQCalculator::ImportDefinitionData()", "", FatalErrorInArgument,
+                    G4String("      invalid tissue weighting factor at " + where).c_str());
+            tissueWeight_Vector.push_back(std::make_pair(tokens.at(1), tissueWeight));
+        }
+        else if(keyword == "remainder" && tokens.size() >= 3)
+        {
+            // Remainder tissues share the weighting factor equally
+            G4double remainderWeight;
+            if(!ParseDouble(tokens.at(1), remainderWeight))
+                G4Exception("MRCPProtQCalculator::ImportDefinitionData()", "", FatalErrorInArgument,
+                    G4String("      invalid remainder weighting factor at " + where).c_str());
+            G4double nRemainder = static_cast<G4double>(tokens.size() - 2);
+            for(size_t i = 2; i < tokens.size(); ++i)
+                tissueWeight_Vector.push_back(std::make_pair(tokens.at(i), remainderWeight / nRemainder));
+        }
+        else if(keyword == "effective" && tokens.size() == 2)
+            AddEffectiveDose(tokens.at(1), where);
+        else if(keyword == "output" && tokens.size() >= 3)
+        {
+            // Label is the rest of the line (may contain spaces)
+            G4String label = tokens.at(2);
+            for(size_t i = 3; i < tokens.size(); ++i)
+                label += " " + tokens.at(i);
+            output_Vector.push_back(std::make_pair(tokens.at(1), label));
+        }
+        else
+            G4Exception("MRCPProtQCalculator::ImportDefinitionData()", "", FatalErrorInArgument,
+                G4String("      invalid definition '" + keyword + "' at " + where).c_str());
     }
+
+    // --- Close the file --- //
+    ifs.close();
+
+    // --- Validate tallied quantities --- //
+    if(output_Vector.empty())
+        G4Exception("MRCPProtQCalculator::ImportDefinitionData()", "", FatalErrorInArgument,
+            G4String("      No output is defined in '" + definitionFilePath + "'").c_str());
+    for(const auto& output: output_Vector)
+        if(!HasOrgan(output.first))
+            G4Exception("MRCPProtQCalculator::ImportDefinitionData()", "", FatalErrorInArgument,
+                G4String("      output '" + output.second + "' refers to undefined organ '" + output.first + "'").c_str());
 }
 
-void MRCPProtQCalculator::Preset_OrganDose()
+void MRCPProtQCalculator::AddOrgan(const G4String& organName, const G4String& weighting,
+                                   const std::vector<G4String>& args, const G4String& where)
 {
-    std::map< Organ, std::vector<SubModel> > organSubModelVec_Map;
+    std::map<G4int, G4double> organWeights;
 
-    // 1. Red bone marrow (Active marrow)
-    organSubModelVec_Map[Organ::RedBoneMarrow] =
-    {
-        SubModel::mHumeriUS,
-        SubModel::mClavicleS,
-        SubModel::mCraniumS,
-        SubModel::mFemoraUS,
-        SubModel::mMandibleS,
-        SubModel::mPelvisS,
-        SubModel::mRibsS,
-        SubModel::mScapulaeS,
-        SubModel::mCervicalS,
-        SubModel::mThoracicS,
-        SubModel::mLumbarS,
-        SubModel::mSacrumS,
-        SubModel::mSternumS
-    };
-
-    // 2. Colon
-    organSubModelVec_Map[Organ::Colon] =
-    {
-        SubModel::mAscColonW_280_300,
-        SubModel::mTransColonWR_280_300,
-        SubModel::mTransColonWL_280_300,
-        SubModel::mDscColonW_280_300,
-        SubModel::mSigColonW_280_300
-    };
-    // 2*. Colon (whole)
-    organSubModelVec_Map[Organ::ColonWhole] =
-    {
-        SubModel::mAscColonW_0_280,
-        SubModel::mAscColonW_280_300,
-        SubModel::mAscColonW_300_surf,
-        SubModel::mTransColonWR_0_280,
-        SubModel::mTransColonWR_280_300,
-        SubModel::mTransColonWR_300_surf,
-        SubModel::mTransColonWL_0_280,
-        SubModel::mTransColonWL_280_300,
-        SubModel::mTransColonWL_300_surf,
-        SubModel::mDscColonW_0_280,
-        SubModel::mDscColonW_280_300,
-        SubModel::mDscColonW_300_surf,
-        SubModel::mSigColonW_0_280,
-        SubModel::mSigColonW_280_300,
-        SubModel::mSigColonW_300_surf,
-        SubModel::mRectumW
-    };
-
-    // 3. Lung
-    organSubModelVec_Map[Organ::Lungs] =
-    {
-        SubModel::mLungR,
-        SubModel::mLungL
-    };
-
-    // 4. Stomach
-    organSubModelVec_Map[Organ::Stomach] =
-    {
-        SubModel::mStomach_60_100
-    };
-    // 4*. Stomach (whole)
-    organSubModelVec_Map[Organ::StomachWhole] =
-    {
-        SubModel::mStomach_0_60,
-        SubModel::mStomach_60_100,
-        SubModel::mStomach_100_300,
-        SubModel::mStomach_300_surf
-    };
-
-    // 5. Breast
-    organSubModelVec_Map[Organ::Breast] =
+    if(weighting == "mass") // Mass ratio of each subModel
     {
-        SubModel::mBreastRA,
-        SubModel::mBreastLA,
-        SubModel::mBreastRG,
-        SubModel::mBreastLG
-    };
-
-    // 6. Gonads
-    organSubModelVec_Map[Organ::Gonads] =
-    {
-        SubModel::mGonadsR,
-        SubModel::mGonadsL
-    };
-
-    // 7. Bladder
-    organSubModelVec_Map[Organ::Bladder] =
-    {
-        SubModel::mUrinarybladder
-    };
+        G4double organMass{0.};
+        for(const auto& arg: args)
+            organMass += fMRCPModel->GetSubModelMass(ToSubModelID(arg, where));
+        if(organMass <= 0.)
+            G4Exception("MRCPProtQCalculator::AddOrgan()", "", FatalErrorInArgument,
+                G4String("      organ '" + organName + "' has no mass at " + where).c_str());
 
-    // 8. Oesophagus
-    organSubModelVec_Map[Organ::Oesophagus] =
+        for(const auto& arg: args)
+        {
+            G4int subModelID = ToSubModelID(arg, where);
+            organWeights[subModelID] += fMRCPModel->GetSubModelMass(subModelID) / organMass;
+        }
+    }
+    else if(weighting == "rbm" || weighting == "bs" || weighting == "drfrbm" || weighting == "drfbs")
     {
-        SubModel::mOesophagus_190_200
-    };
-    // 8*. Oesophagus (whole)
-    organSubModelVec_Map[Organ::OesophagusWhole] =
+        G4bool isRBM = (weighting == "rbm" || weighting == "drfrbm");
+        G4bool isDRF = (weighting == "drfrbm" || weighting == "drfbs");
+        for(const auto& arg: args)
+        {
+            G4int subModelID = ToSubModelID(arg, where);
+            G4double massRatio = isRBM ? fMRCPModel->GetSubModelRBMMassRatio(subModelID)
+                                       : fMRCPModel->GetSubModelBSMassRatio(subModelID);
+
+            // DRF-based doses are stored at -10xx (RBM) & -20xx (BS) (see MRCPPSDoseDeposit::ProcessHits())
+            G4int tallyID = subModelID;
+            if(isDRF) tallyID = (-subModelID) - (isRBM ? 1000 : 2000);
+            if(fMRCPModel->GetDoseTallyIndex(tallyID) < 0)
+                G4Exception("MRCPProtQCalculator::AddOrgan()", "", FatalErrorInArgument,
+                    G4String("      subModel " + arg + " has no RBM & BS data (" + weighting + ") at " + where).c_str());
+
+            organWeights[tallyID] += massRatio;
+        }
+    }
+    else if(weighting == "fixed") // (subModel ID, weighting factor) pairs
     {
-        SubModel::mOesophagus_0_190,
-        SubModel::mOesophagus_190_200,
-        SubModel::mOesophagus_200_surf
-    };
+        if(args.size() % 2)
+            G4Exception("MRCPProtQCalculator::AddOrgan()", "", FatalErrorInArgument,
+                G4String("      'fixed' needs (ID, weight) pairs at " + where).c_str());
+        for(size_t i = 0; i + 1 < args.size(); i += 2)
+        {
+            G4double weight;
+            if(!ParseDouble(args.at(i + 1), weight))
+                G4Exception("MRCPProtQCalculator::AddOrgan()", "", FatalErrorInArgument,
+                    G4String("      invalid weighting factor '" + args.at(i + 1) + "' at " + where).c_str());
+            organWeights[ToSubModelID(args.at(i), where)] += weight;
+        }
+    }
+    else
+        G4Exception("MRCPProtQCalculator::AddOrgan()", "", FatalErrorInArgument,
+            G4String("      invalid weighting '" + weighting + "' at " + where).c_str());
 
-    // 9. Liver
-    organSubModelVec_Map[Organ::Liver] =
-    {
-        SubModel::mLiver
-    };
+    // Lines of the same organ are summed
+    for(const auto& organWeight: organWeights)
+        organWeights_Map[organName][organWeight.first] += organWeight.second;
+}
 
-    // 10. Thyroid
-    organSubModelVec_Map[Organ::Thyroid] =
-    {
-        SubModel::mThyroid
-    };
+void MRCPProtQCalculator::AddWholeBody(const G4String& organName, const std::vector<G4String>& excludedIDs,
+                                       const G4String& where)
+{
+    std::set<G4int> excludedIDSet;
+    for(const auto& excludedID: excludedIDs)
+        excludedIDSet.insert(ToSubModelID(excludedID, where));
 
-    // 11. Bone surface
-    organSubModelVec_Map[Organ::BoneSurface] =
-    {
-        SubModel::mHumeriUS,
-        SubModel::mHumeriLS,
-        SubModel::mHumeriM,
-        SubModel::mUlnaeS,
-        SubModel::mUlnaeM,
-        SubModel::mHandsS,
-        SubModel::mClavicleS,
-        SubModel::mCraniumS,
-        SubModel::mFemoraUS,
-        SubModel::mFemoraLS,
-        SubModel::mFemoraM,
-        SubModel::mTibiaeS,
-        SubModel::mTibiaeM,
-        SubModel::mFootS,
-        SubModel::mMandibleS,
-        SubModel::mPelvisS,
-        SubModel::mRibsS,
-        SubModel::mScapulaeS,
-        SubModel::mCervicalS,
-        SubModel::mThoracicS,
-        SubModel::mLumbarS,
-        SubModel::mSacrumS,
-        SubModel::mSternumS
-    };
-
-    // 12. Brain
-    organSubModelVec_Map[Organ::Brain] =
-    {
-        SubModel::mBrain
-    };
+    // Mass-weighted over all the other subModels (NULL ID -1 excluded)
+    std::vector<G4String> wholeBodyIDs;
+    for(const auto& subModelID: fMRCPModel->GetSubModelIDSet())
+        if(subModelID > 0 && excludedIDSet.find(subModelID) == excludedIDSet.end())
+            wholeBodyIDs.push_back(std::to_string(subModelID));
 
-    // 13. Salivary glands
-    organSubModelVec_Map[Organ::SalivaryGlands] =
-    {
-        SubModel::mSalivary_glandR,
-        SubModel::mSalivary_glandL
-    };
+    AddOrgan(organName, "mass", wholeBodyIDs, where);
+}
 
-    // 14. Skin
-    organSubModelVec_Map[Organ::Skin] =
-    {
-        SubModel::mSkin_50_100
-    };
-    // 14*. Skin (whole)
-    organSubModelVec_Map[Organ::SkinWhole] =
-    {
-        SubModel::mSkin_Osurf_50,
-        SubModel::mSkin_50_100,
-        SubModel::mSkin_100_Isurf
-    };
+void MRCPProtQCalculator::AddCombination(const G4String& organName, const std::vector<G4String>& args,
+                                         const G4String& where)
+{
+    if(args.size() % 2)
+        G4Exception("MRCPProtQCalculator::AddCombination()", "", FatalErrorInArgument,
+            G4String("      'combine' needs (organ, factor) pairs at " + where).c_str());
 
-    // 15. Adrenals
-    organSubModelVec_Map[Organ::Adrenals] =
+    std::map<G4int, G4double> organWeights;
+    for(size_t i = 0; i + 1 < args.size(); i += 2)
     {
-        SubModel::mAdrenalR,
-        SubModel::mAdrenalL
-    };
-
-    // 16. Extrathoracic
-    // Exceptional one. See below.
-    // 16*. Extrathracic (whole)
-    // Exceptional one. See below.
+        G4double factor;
+        if(!HasOrgan(args.at(i)) || !ParseDouble(args.at(i + 1), factor))
+            G4Exception("MRCPProtQCalculator::AddCombination()", "", FatalErrorInArgument,
+                G4String("      invalid organ or factor '" + args.at(i) + " " + args.at(i + 1) + "' at " + where).c_str());
 
-    // 17. Gall bladder
-    organSubModelVec_Map[Organ::GallBladder] =
-    {
-        SubModel::mGallbladder
-    };
+        for(const auto& organWeight: organWeights_Map.at(args.at(i)))
+            organWeights[organWeight.first] += organWeight.second * factor;
+    }
 
-    // 18. Heart
-    organSubModelVec_Map[Organ::Heart] =
-    {
-        SubModel::mHeart
-    };
+    for(const auto& organWeight: organWeights)
+        organWeights_Map[organName][organWeight.first] += organWeight.second;
+}
 
-    // 19. Kidneys
-    organSubModelVec_Map[Organ::Kidneys] =
-    {
-        SubModel::mKidneyRCortex,
-        SubModel::mKidneyRMedulla,
-        SubModel::mKidneyRPelvis,
-        SubModel::mKidneyLCortex,
-        SubModel::mKidneyLMedulla,
-        SubModel::mKidneyLPelvis
-    };
-
-    // 20. Lymphatic nodes
-    organSubModelVec_Map[Organ::LymphaticNodes] =
-    {
-        SubModel::mLymphET,
-        SubModel::mLymphCer,
-        SubModel::mLymphAxi,
-        SubModel::mLymphBre,
-        SubModel::mLymphTho,
-        SubModel::mLymphCub,
-        SubModel::mLymphMes,
-        SubModel::mLymphIng,
-        SubModel::mLymphPop
-    };
-
-    // 21. Muscle
-    organSubModelVec_Map[Organ::Muscle] =
-    {
-        SubModel::mMuscle
-    };
+void MRCPProtQCalculator::AddEffectiveDose(const G4String& organName, const G4String& where)
+{
+    // Tissue weighting factors must sum up to unity
+    G4double totalTissueWeight{0.};
+    std::map<G4int, G4double> organWeights;
+    for(const auto& tissueWeight: tissueWeight_Vector)
+    {
+        if(!HasOrgan(tissueWeight.first))
+            G4Exception("MRCPProtQCalculator::AddEffectiveDose()", "", FatalErrorInArgument,
+                G4String("      undefined tissue '" + tissueWeight.first + "' at " + where).c_str());
+
+        for(const auto& organWeight: organWeights_Map.at(tissueWeight.first))
+            organWeights[organWeight.first] += organWeight.second * tissueWeight.second;
+        totalTissueWeight += tissueWeight.second;
+    }
 
-    // 22. Oral mucosa
-    organSubModelVec_Map[Organ::OralMucosa] =
-    {
-        SubModel::mTongueLower_OralM,
-        SubModel::mMouthFloor_OralM,
-        SubModel::mMouthLibCheek_OralM
-    };
+    if(std::abs(totalTissueWeight - 1.) > 1e-6)
+        G4Exception("MRCPProtQCalculator::AddEffectiveDose()", "", JustWarning,
+            G4String("      sum of tissue weighting factors is " + std::to_string(totalTissueWeight) + " at " + where).c_str());
 
-    // 23. Pancreas
-    organSubModelVec_Map[Organ::Pancreas] =
-    {
-        SubModel::mPancreas
-    };
+    organWeights_Map[organName] = organWeights;
+}
 
-    // 24. Prostate/Uterus
-    organSubModelVec_Map[Organ::ProstateUterus] =
-    {
-        SubModel::mProstate_Uterus
-    };
+G4int MRCPProtQCalculator::ToSubModelID(const G4String& value, const G4String& where) const
+{
+    std::istringstream iss(value);
+    G4int subModelID;
+    iss >> subModelID;
 
-    // 25. Small intestine
-    organSubModelVec_Map[Organ::SmallIntestine] =
-    {
-        SubModel::mSI_130_150
-    };
-    // 25*. Small intestine (whole)
-    organSubModelVec_Map[Organ::SmallIntestineWhole] =
-    {
-        SubModel::mSI_0_130,
-        SubModel::mSI_130_150,
-        SubModel::mSI_150_200,
-        SubModel::mSI_200_surf
-    };
-
-    // 26. Spleen
-    organSubModelVec_Map[Organ::Spleen] =
-    {
-        SubModel::mSpleen
-    };
+    auto subModelIDSet = fMRCPModel->GetSubModelIDSet();
+    if(iss.fail() || !iss.eof() || subModelIDSet.find(subModelID) == subModelIDSet.end())
+        G4Exception("MRCPProtQCalculator::ToSubModelID()", "", FatalErrorInArgument,
+            G4String("      subModel '" + value + "' does not exist in '" + fMRCPModel->GetName() + "' at " + where).c_str());
 
-    // 27. Thymus
-    organSubModelVec_Map[Organ::Thymus] =
-    {
-        SubModel::mThymus
-    };
+    return subModelID;
+}
 
-    // 28. Eye lens
-    organSubModelVec_Map[Organ::EyeLens] =
-    {
-        SubModel::mSensLensR,
-        SubModel::mSensLensL
-    };
-    // 28*. Eye lens (whole)
-    organSubModelVec_Map[Organ::EyeLensWhole] =
-    {
-        SubModel::mSensLensR,
-        SubModel::mSensLensL,
-        SubModel::mInsensLensR,
-        SubModel::mInsensLensL,
-    };
-
-    // --- subModel weighting factor calculation --- //
-    // For all organs (except Organ::WholeBody)
-    for(const auto& organSubModelVec: organSubModelVec_Map)
+void MRCPProtQCalculator::CompileWeightMatrix()
+{
+    // --- Expand organ weights of each output into tally indices & store in CSR format --- //
+    rowOffset_Vector.push_back(0);
+    for(const auto& output: output_Vector)
     {
-        // Calculate mass of the organ
-        G4double organMass{0.};
-        for(const auto& subModel: organSubModelVec.second)
+        std::map<size_t, G4double> rowWeights; // tally index, weight
+        for(const auto& organWeight: organWeights_Map.at(output.first))
         {
-            G4int subModelID = static_cast<G4int>(subModel);
-            G4double subModelMass = fMRCPModel->GetSubModelMass(subModelID);
-
-            organMass += subModelMass;
+            // Validated at loading, so every ID has its tally index
+            G4int tallyIndex = fMRCPModel->GetDoseTallyIndex(organWeight.first);
+            rowWeights[static_cast<size_t>(tallyIndex)] += organWeight.second;
         }
 
-        // Calculate & record mass ratio (weighting factor) of each subModel
-        for(const auto& subModel: organSubModelVec.second)
+        protQName_Vector.push_back(output.second);
+        for(const auto& rowWeight: rowWeights)
         {
-            G4int subModelID = static_cast<G4int>(subModel);
-            G4double subModelMass = fMRCPModel->GetSubModelMass(subModelID);
-
-            protQ_subModelWeights_Map[organSubModelVec.first][subModelID] = subModelMass / organMass;
+            colIndex_Vector.push_back(rowWeight.first);
+            weight_Vector.push_back(rowWeight.second);
         }
+        rowOffset_Vector.push_back(colIndex_Vector.size());
     }
-
-    // --- Organs that which weighting factors are not mass ratio --- //
-    // 1. Red Bone Marrow
-    for(const auto& subModel: organSubModelVec_Map.at(Organ::RedBoneMarrow))
-    {
-        G4int subModelID = static_cast<G4int>(subModel);
-        G4double subModelRBMMassRatio = fMRCPModel->GetSubModelRBMMassRatio(subModelID);
-
-        // RBM dose by using DRF. subModelIDs are -10xx (see MRCPPSDoseDeposit::ProcessHits())
-        protQ_subModelWeights_Map[Organ::RedBoneMarrow][(-subModelID)-1000] = subModelRBMMassRatio;
-        // RBM dose by using only mass ratio.
-        protQ_subModelWeights_Map[Organ::RedBoneMarrow_byMassRatio][subModelID] = subModelRBMMassRatio;
-    }
-
-    // 2. Bone Surface
-    for(const auto& subModel: organSubModelVec_Map.at(Organ::BoneSurface))
-    {
-        G4int subModelID = static_cast<G4int>(subModel);
-        G4double subModelBSMassRatio = fMRCPModel->GetSubModelBSMassRatio(subModelID);
-
-        // BS dose by using DRF. subModelIDs are -20xx (see MRCPPSDoseDeposit::ProcessHits())
-        protQ_subModelWeights_Map[Organ::BoneSurface][(-subModelID)-2000] = subModelBSMassRatio;
-        // BS dose by using only mass ratio.
-        protQ_subModelWeights_Map[Organ::BoneSurface_byMassRatio][subModelID] = subModelBSMassRatio;
-    }
-
-    // 3. Extrathoracic
-    protQ_subModelWeights_Map[Organ::Extrathoracic][static_cast<G4int>(SubModel::mET1_40_50)] = .001;
-    protQ_subModelWeights_Map[Organ::Extrathoracic][static_cast<G4int>(SubModel::mET2_40_50)] = .999;
-
-    // 3*. Extrathoracic (whole)
-    // ET1 region
-    G4double ET1Mass =
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET1_0_8)) +
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET1_8_40)) +
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET1_40_50)) +
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET1_50_Surf));
-    protQ_subModelWeights_Map[Organ::ExtrathoracicWhole][static_cast<G4int>(SubModel::mET1_0_8)] =
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET1_0_8)) / ET1Mass * .001;
-    protQ_subModelWeights_Map[Organ::ExtrathoracicWhole][static_cast<G4int>(SubModel::mET1_8_40)] =
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET1_8_40)) / ET1Mass * .001;
-    protQ_subModelWeights_Map[Organ::ExtrathoracicWhole][static_cast<G4int>(SubModel::mET1_40_50)] =
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET1_40_50)) / ET1Mass * .001;
-    protQ_subModelWeights_Map[Organ::ExtrathoracicWhole][static_cast<G4int>(SubModel::mET1_50_Surf)] =
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET1_40_50)) / ET1Mass * .001;
-    // ET2 region
-    G4double ET2Mass =
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET2_0_40)) +
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET2_40_50)) +
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET2_50_55)) +
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET2_55_65)) +
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET2_65_Surf));
-    protQ_subModelWeights_Map[Organ::ExtrathoracicWhole][static_cast<G4int>(SubModel::mET2_0_40)] =
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET2_0_40)) / ET2Mass * .999;
-    protQ_subModelWeights_Map[Organ::ExtrathoracicWhole][static_cast<G4int>(SubModel::mET2_40_50)] =
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET2_40_50)) / ET2Mass * .999;
-    protQ_subModelWeights_Map[Organ::ExtrathoracicWhole][static_cast<G4int>(SubModel::mET2_50_55)] =
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET2_50_55)) / ET2Mass * .999;
-    protQ_subModelWeights_Map[Organ::ExtrathoracicWhole][static_cast<G4int>(SubModel::mET2_55_65)] =
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET2_55_65)) / ET2Mass * .999;
-    protQ_subModelWeights_Map[Organ::ExtrathoracicWhole][static_cast<G4int>(SubModel::mET2_65_Surf)] =
-            fMRCPModel->GetSubModelMass(static_cast<G4int>(SubModel::mET2_65_Surf)) / ET2Mass * .999;
 }
-
-
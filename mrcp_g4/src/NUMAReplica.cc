@@ -0,0 +1,154 @@
+#include "NUMAReplica.hh"
+#include "MRCPModel.hh"
+
+#include "G4AutoLock.hh"
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+G4Mutex replicaMutex = G4MUTEX_INITIALIZER;
+
+// Parses a sysfs CPU list, e.g. "0-15,32-47"
+std::vector<G4int> ParseCPUList(const std::string& cpuList)
+{
+    std::vector<G4int> cpus;
+    std::stringstream ss(cpuList);
+    std::string range;
+    while(std::getline(ss, range, ','))
+    {
+        if(range.empty()) continue;
+        auto dash = range.find('-');
+        G4int first = std::stoi(range.substr(0, dash));
+        G4int last = (dash==std::string::npos) ? first : std::stoi(range.substr(dash+1));
+        for(G4int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+}
+
+const TETModelReplica* NUMAReplicaStore::GetLocalReplica(const TETModel* tetModel)
+{
+    G4int numaNode = (fReplicaEnabled && !G4Threading::IsMasterThread()) ? GetCurrentNode() : -1;
+
+    // Solids are registered in G4SolidStore when replicated, so replicas are built one at a time
+    G4AutoLock lock(&replicaMutex);
+
+    auto& sharedReplica = replica_Map[std::make_pair(tetModel, -1)];
+    if(!sharedReplica) sharedReplica.reset(BuildSharedReplica(tetModel));
+    if(numaNode < 0) return sharedReplica.get();
+
+    auto& nodeReplica = replica_Map[std::make_pair(tetModel, numaNode)];
+    if(!nodeReplica)
+    {
+        nodeReplica.reset(BuildNodeReplica(sharedReplica.get(), numaNode));
+        G4cout << "  NUMA replica of '" << tetModel->GetName() << "' built on node " << numaNode << G4endl;
+    }
+    return nodeReplica.get();
+}
+
+TETModelReplica* NUMAReplicaStore::BuildSharedReplica(const TETModel* tetModel) const
+{
+    auto replica = new TETModelReplica;
+    replica->tets = tetModel->GetTetVector().data();
+    replica->subModelIDs = tetModel->GetTetSubModelIDVector().data();
+
+    // If the model is MRCPModel, its materials replace the logical volume's material.
+    replica->material_Vector.assign(tetModel->GetNumTets(), nullptr);
+    auto mrcpModel = dynamic_cast<const MRCPModel*>(tetModel);
+    if(mrcpModel)
+        for(size_t i = 0; i < replica->material_Vector.size(); ++i)
+            replica->material_Vector[i] = mrcpModel->GetSubModelMaterial(replica->subModelIDs[i]);
+    replica->materials = replica->material_Vector.data();
+
+    return replica;
+}
+
+TETModelReplica* NUMAReplicaStore::BuildNodeReplica(const TETModelReplica* sharedReplica, G4int numaNode) const
+{
+    // Copied by the calling thread, i.e. allocated on its node
+    size_t numTets = sharedReplica->material_Vector.size();
+
+    auto replica = new TETModelReplica;
+    replica->numaNode = numaNode;
+
+    // Solids are deleted by G4SolidStore, as the original tets
+    replica->tet_Vector.reserve(numTets);
+    for(size_t i = 0; i < numTets; ++i)
+        replica->tet_Vector.push_back(new G4Tet(*sharedReplica->tets[i]));
+    replica->subModelID_Vector.assign(sharedReplica->subModelIDs, sharedReplica->subModelIDs + numTets);
+    replica->material_Vector = sharedReplica->material_Vector;
+
+    replica->tets = replica->tet_Vector.data();
+    replica->subModelIDs = replica->subModelID_Vector.data();
+    replica->materials = replica->material_Vector.data();
+
+    return replica;
+}
+
+G4int NUMAReplicaStore::GetCurrentNode()
+{
+#ifdef __linux__
+    G4int cpu = sched_getcpu();
+    if(cpu < 0) return 0;
+
+    // /sys/devices/system/cpu/cpu<N>/node<K>
+    std::error_code ec;
+    std::filesystem::directory_iterator cpuDir("/sys/devices/system/cpu/cpu" + std::to_string(cpu), ec);
+    if(ec) return 0;
+    for(const auto& entry: cpuDir)
+    {
+        std::string name = entry.path().filename().string();
+        if(name.size() > 4 && name.compare(0, 4, "node")==0 && std::isdigit(name[4]))
+            return std::stoi(name.substr(4));
+    }
+#endif
+    return 0;
+}
+
+std::vector< std::vector<G4int> > NUMAReplicaStore::GetNodeCPUs()
+{
+    std::vector< std::vector<G4int> > nodeCPUs;
+#ifdef __linux__
+    // /sys/devices/system/node/node<K>/cpulist
+    for(G4int node = 0; ; ++node)
+    {
+        std::ifstream ifs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if(!ifs.is_open()) break;
+        std::string cpuList;
+        std::getline(ifs, cpuList);
+        auto cpus = ParseCPUList(cpuList);
+        if(!cpus.empty()) nodeCPUs.push_back(cpus);
+    }
+#endif
+    return nodeCPUs;
+}
+
+void NUMAReplicaStore::PinWorkerThread(G4int threadID)
+{
+#ifdef __linux__
+    static const auto nodeCPUs = GetNodeCPUs(); // read once
+    if(nodeCPUs.empty() || threadID < 0) return;
+
+    // Thread 0 -> node 0, thread 1 -> node 1, ... (round robin), then the next core of each node
+    const auto& cpus = nodeCPUs[static_cast<size_t>(threadID) % nodeCPUs.size()];
+    G4int cpu = cpus[(static_cast<size_t>(threadID) / nodeCPUs.size()) % cpus.size()];
+
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+    if(pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet)!=0)
+        G4Exception("NUMAReplicaStore::PinWorkerThread()", "", JustWarning,
+            G4String("      cannot pin the thread " + std::to_string(threadID) + " to the CPU " + std::to_string(cpu)).c_str());
+#else
+    (void)threadID;
+#endif
+}
@@ -0,0 +1,358 @@
+#include "NuclideLibrary.hh"
+
+#include <fstream>
+#include <regex>
+#include <sstream>
+
+const RadioNuclide::DecayData* NuclideLibrary::GetDecayData(const G4String& decayDataFilePath)
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+
+    auto& decayData = fDecayData_Map[decayDataFilePath];
+    if(!decayData)
+        decayData.reset(new RadioNuclide::DecayData(ReadDecayData(decayDataFilePath)));
+    return decayData.get();
+}
+
+const RadioNuclide::SamplingTable* NuclideLibrary::GetSamplingTable(const G4String& key,
+    const std::function<RadioNuclide::SamplingTable()>& buildSamplingTable)
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+
+    auto& samplingTable = fSamplingTable_Map[key];
+    if(!samplingTable)
+        samplingTable.reset(new RadioNuclide::SamplingTable(buildSamplingTable()));
+    return samplingTable.get();
+}
+
+RadioNuclide::DecayData NuclideLibrary::ReadDecayData(const G4String& decayDataFilePath)
+{
+    // --- Open nuclide data file --- //
+    std::ifstream ifs(decayDataFilePath.c_str());
+    if(!ifs.is_open())
+        G4Exception("NuclideLibrary::ReadDecayData()", "", FatalErrorInArgument,
+            G4String("      No nuclide data file '" + decayDataFilePath + "'" ).c_str());
+
+    G4cout << "  Reading nuclide data file '"
+           << decayDataFilePath << "'" <<G4endl;
+
+    // Lines without the trailing CR of the DOS line ending, if any
+    auto getLine = [&ifs](G4String& line) -> G4bool
+    {
+        if(!std::getline(ifs, line)) return false;
+        if(!line.empty() && line.back()=='\r') line.pop_back();
+        return true;
+    };
+
+    // --- Get data --- //
+    // Find the line "START RADIATION RECORDS"
+    G4String thisLine;
+    while(getLine(thisLine))
+        if(thisLine=="START RADIATION RECORDS") break;
+
+    // Read data until to find the line "END RADIATION RECORDS"
+    RadioNuclide::DecayData decayData;
+    while(getLine(thisLine))
+    {
+        if(thisLine=="END RADIATION RECORDS") break;
+
+        std::stringstream ss(thisLine);
+        G4int iCode;
+        G4double yield;
+        G4double energy;
+        ss >> iCode >> yield >> energy; // followed by the mnemonic
+        if(ss.fail()) continue;
+        decayData[static_cast<RadioNuclide::Radiation>(iCode)][energy*MeV] = yield;
+    }
+
+    return decayData;
+}
+
+G4bool NuclideLibrary::LoadICRP107(const G4String& databasePath)
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+    if(!fICRP107_Map.empty())
+    {
+        if(databasePath!=fICRP107Path)
+            G4Exception("NuclideLibrary::LoadICRP107()", "", JustWarning,
+                G4String("      ICRP107 database is already loaded from '" + fICRP107Path + "'").c_str());
+        return true;
+    }
+
+    std::filesystem::path path(databasePath.c_str());
+    auto cacheFilePath = path/"ICRP-07.bin";
+
+    // Binary cache, if not older than the text files
+    std::error_code ec;
+    G4bool cacheValid = std::filesystem::exists(cacheFilePath, ec);
+    for(const auto& textFileName: {"ICRP-07.NDX", "ICRP-07.RAD", "ICRP-07.BET"})
+        if(cacheValid && std::filesystem::exists(path/textFileName, ec) &&
+           std::filesystem::last_write_time(path/textFileName, ec) > std::filesystem::last_write_time(cacheFilePath, ec))
+            cacheValid = false;
+
+    std::map<G4String, NuclideRecord> nuclides;
+    if(cacheValid && ReadICRP107Binary(cacheFilePath, nuclides))
+        G4cout << "  Reading ICRP107 database cache '" << cacheFilePath.string() << "'" << G4endl;
+    else
+    {
+        nuclides.clear();
+        if(!ReadICRP107Text(path, nuclides))
+        {
+            G4Exception("NuclideLibrary::LoadICRP107()", "", JustWarning,
+                G4String("      cannot read ICRP107 database in '" + databasePath + "'").c_str());
+            return false;
+        }
+        WriteICRP107Binary(cacheFilePath, nuclides);
+    }
+
+    G4cout << "  ICRP107 database: " << nuclides.size() << " nuclides" << G4endl;
+    fICRP107_Map.swap(nuclides);
+    fICRP107Path = databasePath;
+    return true;
+}
+
+const NuclideLibrary::NuclideRecord* NuclideLibrary::GetICRP107Nuclide(const G4String& nuclideName)
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+
+    auto nuclide = fICRP107_Map.find(nuclideName);
+    if(nuclide==fICRP107_Map.end()) return nullptr;
+    return &nuclide->second;
+}
+
+G4bool NuclideLibrary::ReadICRP107Text(const std::filesystem::path& databasePath, std::map<G4String, NuclideRecord>& nuclides)
+{
+    // Layouts assumed (whitespace separated, DOS or Unix line endings):
+    //   NDX: a line per nuclide, starting with its name; its radioactive daughters are the name-like fields
+    //        followed by their branching fractions (other fields are not used)
+    //   RAD: per nuclide, a header "<name> <half-life> <number of records>", then the records "<ICODE> <Y> <E (MeV)> ..."
+    //   BET: per nuclide, a header "<name> <number of points>", then the points "<E (MeV)> <N(E) (/MeV/nt)>"
+    const std::regex nuclideNameRegex("[A-Z][a-z]?-[0-9]+[a-z]*");
+    auto getTokens = [](std::istream& in, std::vector<G4String>& tokens) -> G4bool
+    {
+        G4String line;
+        if(!std::getline(in, line)) return false;
+        std::istringstream iss(line);
+        tokens.clear();
+        for(G4String token; iss >> token; )
+            tokens.push_back(token);
+        return true;
+    };
+    auto toDouble = [](const G4String& token, G4double& value) -> G4bool
+    {
+        std::istringstream iss(token);
+        iss >> value;
+        return !iss.fail() && iss.eof();
+    };
+
+    std::ifstream ifsNDX(databasePath/"ICRP-07.NDX");
+    std::ifstream ifsRAD(databasePath/"ICRP-07.RAD");
+    std::ifstream ifsBET(databasePath/"ICRP-07.BET");
+    if(!ifsNDX.is_open() || !ifsRAD.is_open()) return false;
+
+    G4cout << "  Reading ICRP107 database in '" << databasePath.string() << "'" << G4endl;
+
+    // --- Index: nuclides & decay chains --- //
+    std::vector<G4String> tokens;
+    while(getTokens(ifsNDX, tokens))
+    {
+        if(tokens.empty() || !std::regex_match(tokens[0], nuclideNameRegex)) continue;
+
+        auto& nuclide = nuclides[tokens[0]];
+        for(size_t i = 1; i+1 < tokens.size(); ++i)
+        {
+            G4double branchingFraction;
+            if(std::regex_match(tokens[i], nuclideNameRegex) && toDouble(tokens[i+1], branchingFraction) &&
+               branchingFraction > 0. && branchingFraction <= 1.)
+                nuclide.daughters.push_back(std::make_pair(tokens[i], branchingFraction));
+        }
+    }
+
+    // --- Radiations --- //
+    while(getTokens(ifsRAD, tokens))
+    {
+        if(tokens.size() < 3 || !std::regex_match(tokens[0], nuclideNameRegex)) continue;
+
+        G4double nRecords;
+        if(!toDouble(tokens.back(), nRecords)) continue;
+        auto& decayData = nuclides[tokens[0]].decayData;
+        for(G4int i = 0; i < static_cast<G4int>(nRecords); ++i)
+        {
+            G4String line;
+            if(!std::getline(ifsRAD, line)) return false;
+
+            std::istringstream iss(line);
+            G4int iCode;
+            G4double yield, energy;
+            iss >> iCode >> yield >> energy; // followed by the mnemonic
+            if(iss.fail()) return false;
+            decayData[static_cast<RadioNuclide::Radiation>(iCode)][energy*MeV] = yield;
+        }
+    }
+
+    // --- Beta spectra (tabulated as inverse CDFs) --- //
+    while(ifsBET.is_open() && getTokens(ifsBET, tokens))
+    {
+        if(tokens.size()!=2 || !std::regex_match(tokens[0], nuclideNameRegex)) continue;
+
+        G4double nPoints;
+        if(!toDouble(tokens[1], nPoints)) continue;
+        std::vector<G4double> energies, densities;
+        for(G4int i = 0; i < static_cast<G4int>(nPoints); ++i)
+        {
+            G4String line;
+            if(!std::getline(ifsBET, line)) return false;
+
+            std::istringstream iss(line);
+            G4double energy, density;
+            iss >> energy >> density;
+            if(iss.fail()) return false;
+            energies.push_back(energy*MeV);
+            densities.push_back(density);
+        }
+
+        auto nuclide = nuclides.find(tokens[0]);
+        if(nuclide!=nuclides.end() && energies.size() >= 2)
+            nuclide->second.betaSpectrum = InverseCDFTable(energies, densities);
+    }
+
+    // Nuclides without radiation records are not usable (e.g. stable ones listed in the index)
+    for(auto itr = nuclides.begin(); itr!=nuclides.end(); )
+    {
+        if(itr->second.decayData.empty())
+            itr = nuclides.erase(itr);
+        else
+            ++itr;
+    }
+
+    return !nuclides.empty();
+}
+
+namespace
+{
+const G4String kICRP107CacheMagic = "MRCP-ICRP107-CACHE-1";
+
+template<typename T> void WriteBinary(std::ostream& out, const T& value)
+{ out.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+template<typename T> void ReadBinary(std::istream& in, T& value)
+{ in.read(reinterpret_cast<char*>(&value), sizeof(T)); }
+
+void WriteBinary(std::ostream& out, const G4String& value)
+{
+    WriteBinary(out, static_cast<uint64_t>(value.size()));
+    out.write(value.data(), value.size());
+}
+void ReadBinary(std::istream& in, G4String& value)
+{
+    uint64_t size(0);
+    ReadBinary(in, size);
+    if(!in || size > (1 << 20)) { in.setstate(std::ios::failbit); return; }
+    value.resize(size);
+    in.read(&value[0], size);
+}
+}
+
+G4bool NuclideLibrary::ReadICRP107Binary(const std::filesystem::path& cacheFilePath, std::map<G4String, NuclideRecord>& nuclides)
+{
+    std::ifstream ifs(cacheFilePath, std::ios::binary);
+    G4String magic;
+    ReadBinary(ifs, magic);
+    if(!ifs || magic!=kICRP107CacheMagic) return false;
+
+    uint64_t nNuclides(0);
+    ReadBinary(ifs, nNuclides);
+    for(uint64_t n = 0; n < nNuclides && ifs; ++n)
+    {
+        G4String nuclideName;
+        ReadBinary(ifs, nuclideName);
+        auto& nuclide = nuclides[nuclideName];
+
+        uint64_t nDaughters(0);
+        ReadBinary(ifs, nDaughters);
+        for(uint64_t i = 0; i < nDaughters && ifs; ++i)
+        {
+            std::pair<G4String, G4double> daughter;
+            ReadBinary(ifs, daughter.first);
+            ReadBinary(ifs, daughter.second);
+            nuclide.daughters.push_back(daughter);
+        }
+
+        uint64_t nRadiations(0);
+        ReadBinary(ifs, nRadiations);
+        for(uint64_t i = 0; i < nRadiations && ifs; ++i)
+        {
+            int32_t iCode(0);
+            uint64_t nLines(0);
+            ReadBinary(ifs, iCode);
+            ReadBinary(ifs, nLines);
+            auto& energyYieldData = nuclide.decayData[static_cast<RadioNuclide::Radiation>(iCode)];
+            for(uint64_t j = 0; j < nLines && ifs; ++j)
+            {
+                G4double energy(0.), yield(0.);
+                ReadBinary(ifs, energy);
+                ReadBinary(ifs, yield);
+                energyYieldData[energy] = yield;
+            }
+        }
+
+        uint64_t nQuantiles(0);
+        ReadBinary(ifs, nQuantiles);
+        if(!ifs || nQuantiles > (1 << 20)) return false;
+        if(nQuantiles > 0)
+        {
+            std::vector<G4double> quantiles(nQuantiles);
+            ifs.read(reinterpret_cast<char*>(quantiles.data()), nQuantiles * sizeof(G4double));
+            nuclide.betaSpectrum = InverseCDFTable(quantiles);
+        }
+    }
+
+    return ifs.good() && !nuclides.empty();
+}
+
+void NuclideLibrary::WriteICRP107Binary(const std::filesystem::path& cacheFilePath, const std::map<G4String, NuclideRecord>& nuclides)
+{
+    // Written to a temporary file first, so that a cache is never read half-written
+    auto tmpFilePath = cacheFilePath;
+    tmpFilePath += ".tmp";
+    {
+        std::ofstream ofs(tmpFilePath, std::ios::binary);
+        WriteBinary(ofs, kICRP107CacheMagic);
+        WriteBinary(ofs, static_cast<uint64_t>(nuclides.size()));
+        for(const auto& nuclide: nuclides)
+        {
+            WriteBinary(ofs, nuclide.first);
+
+            WriteBinary(ofs, static_cast<uint64_t>(nuclide.second.daughters.size()));
+            for(const auto& daughter: nuclide.second.daughters)
+            {
+                WriteBinary(ofs, daughter.first);
+                WriteBinary(ofs, daughter.second);
+            }
+
+            WriteBinary(ofs, static_cast<uint64_t>(nuclide.second.decayData.size()));
+            for(const auto& decayData: nuclide.second.decayData)
+            {
+                WriteBinary(ofs, static_cast<int32_t>(decayData.first));
+                WriteBinary(ofs, static_cast<uint64_t>(decayData.second.size()));
+                for(const auto& energyYieldData: decayData.second)
+                {
+                    WriteBinary(ofs, energyYieldData.first);
+                    WriteBinary(ofs, energyYieldData.second);
+                }
+            }
+
+            const auto& quantiles = nuclide.second.betaSpectrum.GetQuantiles();
+            WriteBinary(ofs, static_cast<uint64_t>(quantiles.size()));
+            ofs.write(reinterpret_cast<const char*>(quantiles.data()), quantiles.size() * sizeof(G4double));
+        }
+        if(!ofs.good())
+        {
+            G4Exception("NuclideLibrary::WriteICRP107Binary()", "", JustWarning,
+                G4String("      cannot write the ICRP107 database cache '" + cacheFilePath.string() + "'").c_str());
+            return;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmpFilePath, cacheFilePath, ec);
+}
@@ -0,0 +1,249 @@
+#include "PhaseSpace.hh"
+
+#include "G4EventManager.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4SystemOfUnits.hh"
+
+#include <cstring>
+#include <map>
+#include <memory>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const char kPhaseSpaceMagic[16] = "MRCP-PHSP-1";
+const size_t kBufferSize = 8192; // records per thread buffer (288 kB)
+}
+
+G4ThreadLocal std::vector<PhaseSpaceRecord>* PhaseSpaceWriter::fBuffer = nullptr;
+G4ThreadLocal const G4VPhysicalVolume* PhaseSpaceWriter::fPhantomBox = nullptr;
+G4ThreadLocal PhaseSpaceWriter::RecordedTracks* PhaseSpaceWriter::fRecordedTracks = nullptr;
+
+PhaseSpaceWriter::PhaseSpaceWriter()
+: fWriting(false), fKillAtEntry(true), fNRecords(0), fNHistories(0)
+{
+    // Messenger setting (master only: the file is shared by all threads)
+    fMessenger = new G4GenericMessenger(this, "/MRCP/phsp/", "Phase-space file of the particles entering the phantom box");
+
+    auto& writeCmd =
+            fMessenger->DeclareMethod("write", &PhaseSpaceWriter::Open,
+                "Record the particles entering the phantom box in the following runs (the file is overwritten).");
+    writeCmd.SetParameterName("fileName", false);
+    writeCmd.SetToBeBroadcasted(false);
+
+    auto& closeCmd =
+            fMessenger->DeclareMethod("close", &PhaseSpaceWriter::Close,
+                "Stop recording and close the phase-space file.");
+    closeCmd.SetToBeBroadcasted(false);
+
+    auto& killAtEntryCmd =
+            fMessenger->DeclareProperty("killAtEntry", fKillAtEntry,
+                "Kill the recorded particles (no transport in the phantom while writing), default: true.");
+    killAtEntryCmd.SetParameterName("killAtEntry", false);
+    killAtEntryCmd.SetToBeBroadcasted(false);
+}
+
+PhaseSpaceWriter::~PhaseSpaceWriter()
+{
+    Close();
+    delete fMessenger;
+}
+
+void PhaseSpaceWriter::Open(const G4String& fileName)
+{
+    Close();
+
+    std::lock_guard<std::mutex> lock(fFileMutex);
+    fOfs.open(fileName, std::ios::binary | std::ios::trunc);
+    if(!fOfs.is_open())
+    {
+        G4Exception("PhaseSpaceWriter::Open()", "", JustWarning,
+            G4String("      cannot open the phase-space file: " + fileName).c_str());
+        return;
+    }
+    fFileName = fileName;
+    fNRecords = 0;
+    fNHistories = 0;
+    WriteHeader();
+    fWriting = true;
+
+    G4cout << " Phase-space file (particles entering the phantom box): " << fFileName
+           << (fKillAtEntry ? ", killed at entry" : "") << G4endl;
+}
+
+void PhaseSpaceWriter::Close()
+{
+    if(!IsWriting()) return;
+    FlushThreadBuffer(); // sequential mode
+
+    std::lock_guard<std::mutex> lock(fFileMutex);
+    fWriting = false;
+    WriteHeader();
+    fOfs.close();
+
+    G4cout << " Phase-space file closed: " << fFileName << " (" << fNRecords << " particles, "
+           << fNHistories << " histories)" << G4endl;
+}
+
+void PhaseSpaceWriter::WriteHeader()
+{
+    PhaseSpaceHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kPhaseSpaceMagic, sizeof(header.magic));
+    header.nRecords = fNRecords;
+    header.nHistories = fNHistories;
+
+    fOfs.seekp(0);
+    fOfs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fOfs.seekp(0, std::ios::end);
+    fOfs.flush();
+}
+
+void PhaseSpaceWriter::Record(const G4Step* step)
+{
+    // Only the steps entering the phantom box from outside
+    auto postStepPoint = step->GetPostStepPoint();
+    if(postStepPoint->GetStepStatus()!=fGeomBoundary) return;
+
+    if(!fPhantomBox) fPhantomBox = G4PhysicalVolumeStore::GetInstance()->GetVolume("PhantomBox", false);
+    if(!fPhantomBox || postStepPoint->GetPhysicalVolume()!=fPhantomBox
+       || step->GetPreStepPoint()->GetPhysicalVolume()==fPhantomBox) return;
+
+    auto track = step->GetTrack();
+
+    // A track coming back into the box (not killed at entry) is already in the phase space
+    if(!fKillAtEntry)
+    {
+        if(!fRecordedTracks) fRecordedTracks = new RecordedTracks;
+        G4int eventID = G4EventManager::GetEventManager()->GetConstCurrentEvent()->GetEventID();
+        if(eventID!=fRecordedTracks->eventID)
+        {
+            fRecordedTracks->eventID = eventID;
+            fRecordedTracks->trackID_Set.clear();
+        }
+        if(!fRecordedTracks->trackID_Set.insert(track->GetTrackID()).second) return;
+    }
+
+    const auto& position = postStepPoint->GetPosition();
+    const auto& direction = postStepPoint->GetMomentumDirection();
+
+    PhaseSpaceRecord record;
+    record.pdgCode = track->GetDefinition()->GetPDGEncoding();
+    record.energy = static_cast<float>(postStepPoint->GetKineticEnergy()/MeV);
+    record.position[0] = static_cast<float>(position.x()/cm);
+    record.position[1] = static_cast<float>(position.y()/cm);
+    record.position[2] = static_cast<float>(position.z()/cm);
+    record.direction[0] = static_cast<float>(direction.x());
+    record.direction[1] = static_cast<float>(direction.y());
+    record.direction[2] = static_cast<float>(direction.z());
+    record.weight = static_cast<float>(postStepPoint->GetWeight());
+
+    if(!fBuffer)
+    {
+        fBuffer = new std::vector<PhaseSpaceRecord>;
+        fBuffer->reserve(kBufferSize);
+    }
+    fBuffer->push_back(record);
+    if(fBuffer->size() >= kBufferSize) FlushThreadBuffer();
+
+    if(fKillAtEntry) track->SetTrackStatus(fStopAndKill);
+}
+
+void PhaseSpaceWriter::FlushThreadBuffer()
+{
+    if(!fBuffer || fBuffer->empty()) return;
+
+    std::lock_guard<std::mutex> lock(fFileMutex);
+    if(fOfs.is_open())
+    {
+        fOfs.write(reinterpret_cast<const char*>(fBuffer->data()), fBuffer->size() * sizeof(PhaseSpaceRecord));
+        fNRecords += fBuffer->size();
+    }
+    fBuffer->clear();
+}
+
+void PhaseSpaceWriter::EndOfRun(G4long nEvents)
+{
+    if(!IsWriting()) return;
+
+    std::lock_guard<std::mutex> lock(fFileMutex);
+    fNHistories += nEvents;
+    WriteHeader(); // the file is complete after each run
+}
+
+const PhaseSpaceFile* PhaseSpaceFile::Open(const G4String& fileName)
+{
+    static std::mutex fileMutex;
+    static std::map< G4String, std::unique_ptr<const PhaseSpaceFile> > file_Map;
+
+    std::lock_guard<std::mutex> lock(fileMutex);
+    auto& file = file_Map[fileName];
+    if(file) return file.get();
+
+    std::unique_ptr<PhaseSpaceFile> newFile(new PhaseSpaceFile);
+    size_t fileSize = 0;
+#if defined(__unix__) || defined(__APPLE__)
+    G4int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0) return nullptr;
+    struct stat fileStat;
+    if(fstat(fd, &fileStat)==0 && fileStat.st_size >= static_cast<off_t>(sizeof(PhaseSpaceHeader)))
+    {
+        fileSize = static_cast<size_t>(fileStat.st_size);
+        void* map = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+        if(map!=MAP_FAILED)
+        {
+            madvise(map, fileSize, MADV_SEQUENTIAL); // each thread reads its partition in order
+            newFile->fMap = map;
+            newFile->fMapSize = fileSize;
+        }
+    }
+    close(fd);
+#else
+    // Without mmap, the whole file in memory
+    std::ifstream ifs(fileName, std::ios::binary | std::ios::ate);
+    if(ifs.is_open() && static_cast<size_t>(ifs.tellg()) >= sizeof(PhaseSpaceHeader))
+    {
+        fileSize = static_cast<size_t>(ifs.tellg());
+        auto data = new char[fileSize];
+        ifs.seekg(0);
+        if(ifs.read(data, fileSize))
+        {
+            newFile->fMap = data;
+            newFile->fMapSize = fileSize;
+        }
+        else delete[] data;
+    }
+#endif
+    if(!newFile->fMap) return nullptr;
+
+    PhaseSpaceHeader header;
+    std::memcpy(&header, newFile->fMap, sizeof(header));
+    if(std::memcmp(header.magic, kPhaseSpaceMagic, sizeof(header.magic))!=0) return nullptr;
+
+    // Records after the header count (e.g. an interrupted run) are also used
+    newFile->fRecords = reinterpret_cast<const PhaseSpaceRecord*>(static_cast<const char*>(newFile->fMap) + sizeof(header));
+    newFile->fNRecords = (fileSize - sizeof(header)) / sizeof(PhaseSpaceRecord);
+    newFile->fNHistories = header.nHistories;
+    if(newFile->fNRecords!=header.nRecords)
+        G4Exception("PhaseSpaceFile::Open()", "", JustWarning,
+            G4String("      " + fileName + ": the number of records differs from the header (not closed?)").c_str());
+
+    file = std::move(newFile);
+    return file.get();
+}
+
+PhaseSpaceFile::~PhaseSpaceFile()
+{
+    if(!fMap) return;
+#if defined(__unix__) || defined(__APPLE__)
+    munmap(fMap, fMapSize);
+#else
+    delete[] static_cast<char*>(fMap);
+#endif
+}
@@ -1,12 +1,33 @@
 #include "PrimarySamplingHelper.hh"
+#include "NuclideLibrary.hh"
 
-G4ThreeVector SampleDirectionFromTo(const G4ThreeVector& referencePoint,
-                                    const G4String& physicalVolumeName,
-                                    G4double& particleWeight,
-                                    G4double margin)
+#include "G4ParticleTable.hh"
+#include "G4UIcommand.hh"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <tuple>
+
+namespace
 {
-    // No physical volume setting
-    if(!physicalVolumeName.size()) return G4RandomDirection();
+// The biasing cone from a point to a physical volume, fixed for the point, volume & margin
+struct DirectionCone
+{
+    G4bool isotropic = true; // no biasing (no/invalid volume, or the point in its bounding box)
+    G4double cosTheta = 1.;
+    G4double weightFactor = 1.; // solid angle reduction
+    G4RotationMatrix rotation; // z axis to the volume
+    G4double sign = 1.; // instead of the rotation, if the volume is along the z axis
+};
+
+DirectionCone CalculateDirectionCone(const G4ThreeVector& referencePoint, const G4String& physicalVolumeName, G4double margin)
+{
+    DirectionCone cone;
 
     // Invalid physical volume name
     auto physicalVolume = G4PhysicalVolumeStore::GetInstance()->GetVolume(physicalVolumeName);
@@ -14,7 +35,7 @@ G4ThreeVector SampleDirectionFromTo(const G4ThreeVector& referencePoint,
     {
         G4Exception("RandomDirectionFromTo()", "", JustWarning,
                     G4String("      invalid physical volume '" + physicalVolumeName + "'" ).c_str());
-        return G4RandomDirection();
+        return cone;
     }
 
     // Get the envelope box of the physical volume
@@ -48,83 +69,251 @@ G4ThreeVector SampleDirectionFromTo(const G4ThreeVector& referencePoint,
         maxTheta = (target2VertexAngle>maxTheta) ? target2VertexAngle : maxTheta;
     }
 
-    // If the ref point is in the bounding box of the physical volume, return 4pi dir.
+    // If the ref point is in the bounding box of the physical volume, 4pi dir.
     G4double cosTheta = std::cos(maxTheta);
-    if(cosTheta<=0.) return G4RandomDirection();
+    if(cosTheta<=0.) return cone;
+
+    cone.isotropic = false;
+    cone.cosTheta = cosTheta;
 
-    // Multiply particle weight as its solid angle reduction
+    // Particle weight multiplied as its solid angle reduction
     G4double solidAngle = CLHEP::twopi * (1 - cosTheta);
-    particleWeight *= solidAngle / (4 * CLHEP::pi);
+    cone.weightFactor = solidAngle / (4 * CLHEP::pi);
 
-    // Sample a direction and rotate to targetVector
-    G4ThreeVector dirVec = G4RandomDirection(cosTheta);
+    // Rotation of the sampled direction to targetVector
     G4ThreeVector zUnit = G4ThreeVector(0., 0., 1);
+    cone.rotation = G4RotationMatrix();
+    cone.sign = 1.;
     if(!(targetVector.isParallel(zUnit)))
-        dirVec.rotate(zUnit.cross(targetVector), zUnit.angle(targetVector));
+        cone.rotation = G4RotationMatrix(zUnit.cross(targetVector), zUnit.angle(targetVector));
     else
-        dirVec *= targetVector.unit().dot(zUnit);
+        cone.sign = targetVector.unit().dot(zUnit);
+    return cone;
+}
+}
 
-    return dirVec;
+G4ThreeVector SampleDirectionFromTo(const G4ThreeVector& referencePoint,
+                                    const G4String& physicalVolumeName,
+                                    G4double& particleWeight,
+                                    G4double margin)
+{
+    // No physical volume setting
+    if(!physicalVolumeName.size()) return G4RandomDirection();
+
+    // A cone per source position, volume & margin (per thread; the geometry is fixed after the initialization),
+    // so that the positions visited in turn (/gun/addPosition) are not calculated again at every event
+    using ConeKey = std::tuple<G4double, G4double, G4double, G4String, G4double>;
+    static G4ThreadLocal std::map<ConeKey, DirectionCone>* cone_Map = nullptr;
+    if(!cone_Map) cone_Map = new std::map<ConeKey, DirectionCone>;
+
+    auto key = std::make_tuple(referencePoint.x(), referencePoint.y(), referencePoint.z(), physicalVolumeName, margin);
+    auto cone = cone_Map->find(key);
+    if(cone==cone_Map->end())
+    {
+        if(cone_Map->size() >= 1024) cone_Map->clear();
+        cone = cone_Map->emplace(key, CalculateDirectionCone(referencePoint, physicalVolumeName, margin)).first;
+    }
+
+    if(cone->second.isotropic) return G4RandomDirection();
+
+    particleWeight *= cone->second.weightFactor;
+
+    // Sample a direction and rotate to the volume
+    G4ThreeVector dirVec = G4RandomDirection(cone->second.cosTheta);
+    if(cone->second.sign!=1.) return dirVec * cone->second.sign;
+    return cone->second.rotation * dirVec;
 }
 
-RadioNuclide::RadioNuclide(G4String name, const G4String& decayDataFilePath, G4double branchingRatio)
-    : fRadioNuclideName(name), fBranchingRatio(branchingRatio)
+AliasTable::AliasTable(const std::vector<G4double>& weights)
+: fProbability(weights.size(), 1.), fAlias(weights.size())
 {
-    // --- Open nuclide data file --- //
-    // *.RAD file exported from DECDATA Program (ICRP107)
-    std::ifstream ifs(decayDataFilePath.c_str());
-    if(!ifs.is_open())
-        G4Exception("SampleDecayProduct()", "", FatalErrorInArgument,
-            G4String("      No nuclide data file '" + decayDataFilePath + "'" ).c_str());
+    G4double totalWeight = 0.;
+    for(const auto& weight: weights)
+        totalWeight += weight;
+
+    // Scaled probabilities (mean 1), split into the columns under & over the mean
+    std::vector<G4double> scaledProbability(weights.size());
+    std::vector<size_t> small, large;
+    for(size_t i = 0; i < weights.size(); ++i)
+    {
+        scaledProbability[i] = weights[i] * weights.size() / totalWeight;
+        fAlias[i] = i;
+        if(scaledProbability[i] < 1.) small.push_back(i);
+        else large.push_back(i);
+    }
+
+    // Fill each small column with a large one, which becomes its alias
+    while(!small.empty() && !large.empty())
+    {
+        size_t s = small.back(); small.pop_back();
+        size_t l = large.back();
 
-    G4cout << "  Reading nuclide data file '"
-           << decayDataFilePath << "'" <<G4endl;
+        fProbability[s] = scaledProbability[s];
+        fAlias[s] = l;
 
-    // --- Get data --- //
-    // Find the line "START RADIATION RECORDS"
-    while(!ifs.eof())
+        scaledProbability[l] -= 1. - scaledProbability[s];
+        if(scaledProbability[l] < 1.)
+        {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // The remaining columns are full (up to round-off)
+}
+
+InverseCDFTable::InverseCDFTable(const std::vector<G4double>& x, const std::vector<G4double>& density, size_t nQuantiles)
+{
+    // --- Cumulative probabilities at the points (trapezoids of the piecewise-linear density) --- //
+    std::vector<G4double> cdf(x.size(), 0.);
+    for(size_t i = 1; i < x.size(); ++i)
+        cdf[i] = cdf[i-1] + 0.5 * (density[i-1] + density[i]) * (x[i] - x[i-1]);
+    if(x.size() < 2 || cdf.back() <= 0.) return;
+
+    // --- x at the cumulative probabilities k/(n-1): F(x) is quadratic within a segment --- //
+    fQuantiles.resize(nQuantiles);
+    size_t i = 1;
+    for(size_t k = 0; k < nQuantiles; ++k)
     {
-        // Get each line
-        G4String thisLine;
-        std::getline(ifs, thisLine);
+        G4double target = cdf.back() * k / (nQuantiles - 1);
+        while(i < x.size() - 1 && cdf[i] < target) ++i;
+
+        G4double dx = x[i] - x[i-1];
+        G4double slope = (dx > 0.) ? (density[i] - density[i-1]) / dx : 0.;
+        G4double area = target - cdf[i-1];
+        // density[i-1]*t + slope/2*t^2 = area (the root in the form stable for slope -> 0)
+        G4double denominator = density[i-1] + std::sqrt(std::max(0., density[i-1] * density[i-1] + 2. * slope * area));
+        G4double t = (denominator > 0.) ? 2. * area / denominator : 0.;
+        fQuantiles[k] = x[i-1] + std::min(std::max(t, 0.), dx);
+    }
+    fQuantiles.front() = x.front();
+    fQuantiles.back() = x.back();
+}
+
+const EnergySpectrum* EnergySpectrum::GetSpectrum(const G4String& spectrumFilePath)
+{
+    static std::mutex spectrumMutex;
+    static std::map< G4String, std::unique_ptr<const EnergySpectrum> > spectrum_Map;
 
-        if(thisLine=="START RADIATION RECORDS\r") break;
+    std::lock_guard<std::mutex> lock(spectrumMutex);
+    auto& spectrum = spectrum_Map[spectrumFilePath];
+    if(!spectrum)
+    {
+        std::unique_ptr<EnergySpectrum> newSpectrum(new EnergySpectrum);
+        if(!newSpectrum->Load(spectrumFilePath)) return nullptr;
+        spectrum = std::move(newSpectrum);
     }
+    return spectrum.get();
+}
 
-    // Read data until to find the line "END RADIATION RECORDS"
-    while(!ifs.eof())
+G4bool EnergySpectrum::Load(const G4String& spectrumFilePath)
+{
+    std::ifstream ifs(spectrumFilePath);
+    if(!ifs.is_open()) return false;
+
+    std::vector<G4double> probability_Vector;
+    G4double unit = MeV;
+    G4double totalProbability = 0.;
+    G4String line;
+    while(std::getline(ifs, line))
     {
-        // Get each line
-        G4String thisLine;
-        std::getline(ifs, thisLine);
+        auto comment = line.find('#');
+        if(comment!=std::string::npos) line = line.substr(0, comment);
+
+        std::istringstream iss(line);
+        std::vector<G4String> token_Vector;
+        G4String token;
+        while(iss >> token)
+            token_Vector.push_back(token);
+        if(token_Vector.empty()) continue;
+
+        if(token_Vector[0]=="unit" && token_Vector.size()==2)
+        {
+            unit = G4UIcommand::ValueOf(token_Vector[1]);
+            if(unit <= 0.) return false;
+            continue;
+        }
 
-        if(thisLine=="END RADIATION RECORDS\r") break;
+        std::vector<G4double> value_Vector;
+        for(const auto& value: token_Vector)
+        {
+            std::istringstream valueStream(value);
+            G4double number;
+            if(!(valueStream >> number) || !valueStream.eof()) return false;
+            value_Vector.push_back(number);
+        }
 
-        DecayData decayData;
-        std::stringstream ss(thisLine);
-        G4int iCode;
-        G4double yield;
-        G4double energy;
-        G4String mnemonic;
-        ss >> iCode >> yield >> energy >> mnemonic;
-        fDecayData[static_cast<Radiation>(iCode)][energy*MeV] = yield;
+        G4double lowerEdge = value_Vector[0] * unit, width = 0., probability;
+        if(value_Vector.size()==2) probability = value_Vector[1];
+        else if(value_Vector.size()==3)
+        {
+            width = value_Vector[1] * unit - lowerEdge;
+            probability = value_Vector[2];
+        }
+        else return false;
+        if(lowerEdge < 0. || width < 0. || probability < 0.) return false;
+        if(probability==0.) continue;
+
+        fLowerEdge_Vector.push_back(lowerEdge);
+        fWidth_Vector.push_back(width);
+        probability_Vector.push_back(probability);
+        totalProbability += probability;
+        fMeanEnergy += probability * (lowerEdge + 0.5 * width);
     }
+    if(probability_Vector.empty()) return false;
 
-    // --- Close the file --- //
-    ifs.close();
+    fAliasTable = AliasTable(probability_Vector);
+    fMeanEnergy /= totalProbability;
+    return true;
+}
+
+RadioNuclide::RadioNuclide(G4String name, const G4String& decayDataFilePath, G4double branchingRatio)
+    : fRadioNuclideName(name), fDecayDataKey(decayDataFilePath), fBranchingRatio(branchingRatio),
+      fBetaSpectrum(nullptr), fSamplingTable(nullptr), fNormalized(false)
+{
+    // Parsed once per process, shared by all threads
+    fDecayData = NuclideLibrary::GetInstance()->GetDecayData(decayDataFilePath);
 }
 
+RadioNuclide::RadioNuclide(G4String name, const DecayData* decayData, const InverseCDFTable* betaSpectrum,
+                           G4double branchingRatio)
+    : fRadioNuclideName(name), fDecayDataKey("ICRP107:" + name), fBranchingRatio(branchingRatio),
+      fDecayData(decayData), fBetaSpectrum(betaSpectrum), fSamplingTable(nullptr), fNormalized(false)
+{}
+
 RadioNuclide::~RadioNuclide()
 {
     for(auto& radioactiveDaughter: fRadioactiveDaughters)
         delete radioactiveDaughter;
 }
 
+RadioNuclide::DecayData RadioNuclide::GetDecayDataInteresting() const
+{
+    DecayData decayDataInteresting;
+    for(const auto& interestingRadiation: fInterestingRadiation_Map)
+    {
+        const auto& radiation = interestingRadiation.first;
+        auto yieldThreshold = fYieldThreshold_Map.find(radiation);
+
+        auto& energyYieldDataInteresting = decayDataInteresting[radiation];
+        for(const auto& energyYieldData: fDecayData->at(radiation))
+        {
+            if(energyYieldData.first<interestingRadiation.second) continue;
+            if(yieldThreshold!=fYieldThreshold_Map.end() && energyYieldData.second<yieldThreshold->second) continue;
+            energyYieldDataInteresting.insert(energyYieldData);
+        }
+    }
+    return decayDataInteresting;
+}
+
 void RadioNuclide::AddInterestingRadiation(Radiation radiation)
 {
     fNormalized = false;
-    if(fDecayData.find(radiation)!=fDecayData.end())
-        fDecayDataInteresting[radiation] = fDecayData.at(radiation);
+    if(fDecayData->find(radiation)==fDecayData->end())
+        return;
+
+    // All data of the radiation, without thresholds
+    fInterestingRadiation_Map[radiation] = 0.;
+    fYieldThreshold_Map.erase(radiation);
 }
 
 void RadioNuclide::AddInterestingRadiation(std::vector<Radiation> radiations)
@@ -136,98 +325,135 @@ void RadioNuclide::AddInterestingRadiation(std::vector<Radiation> radiations)
 void RadioNuclide::RemoveInterestingRadiation(Radiation radiation)
 {
     fNormalized = false;
-    fDecayDataInteresting.erase(radiation);
+    fInterestingRadiation_Map.erase(radiation);
+    fYieldThreshold_Map.erase(radiation);
+}
+
+void RadioNuclide::ClearInterestingRadiation()
+{
+    fNormalized = false;
+    fInterestingRadiation_Map.clear();
+    fYieldThreshold_Map.clear();
 }
 
 void RadioNuclide::SetRadiationEnergyThreshold(Radiation radiation, G4double energy)
 {
     fNormalized = false;
 
-    if(fDecayDataInteresting.find(radiation)==fDecayDataInteresting.end())
+    auto interestingRadiation = fInterestingRadiation_Map.find(radiation);
+    if(interestingRadiation==fInterestingRadiation_Map.end())
         return;
 
-    // for(const auto& energyYieldData: fDecayDataInteresting.at(radiation))
-    //     if(energyYieldData.first<energy)
-    //         fDecayDataInteresting[radiation].erase(energyYieldData.first);
-    for(auto itr = fDecayDataInteresting.at(radiation).begin(); itr!=fDecayDataInteresting.at(radiation).end(); )
-    {
-        if(itr->first<energy)
-            fDecayDataInteresting[radiation].erase(itr++);
-        else
-            ++itr;
-    }
+    interestingRadiation->second = std::max(interestingRadiation->second, energy);
 }
 
 void RadioNuclide::SetRadiationYieldThreshold(Radiation radiation, G4double yield)
 {
     fNormalized = false;
 
-    if(fDecayDataInteresting.find(radiation)==fDecayDataInteresting.end())
+    if(fInterestingRadiation_Map.find(radiation)==fInterestingRadiation_Map.end())
         return;
 
-    // for(const auto& energyYieldData: fDecayDataInteresting.at(radiation))
-    //     if(energyYieldData.second<yield)
-    //         fDecayDataInteresting[radiation].erase(energyYieldData.first);
-    for(auto itr = fDecayDataInteresting.at(radiation).begin(); itr!=fDecayDataInteresting.at(radiation).end(); )
-    {
-        if(itr->second<yield)
-            fDecayDataInteresting[radiation].erase(itr++);
-        else
-            ++itr;
-    }
+    auto yieldThreshold = fYieldThreshold_Map.find(radiation);
+    if(yieldThreshold==fYieldThreshold_Map.end())
+        fYieldThreshold_Map[radiation] = yield;
+    else
+        yieldThreshold->second = std::max(yieldThreshold->second, yield);
 }
 
 void RadioNuclide::Normalize()
 {
-    // --- Calculate total yield --- //
-    fTotalYield = 0.;
-    // Itself
-    for(const auto& decayData: fDecayDataInteresting)
-        for(const auto& energyYieldData: decayData.second)
-            fTotalYield += energyYieldData.second;
-    // Its radioactive daughters
-    for(const auto& radioactiveDaughter: fRadioactiveDaughters)
-        for(const auto& decayData: radioactiveDaughter->fDecayDataInteresting)
-            for(const auto& energyYieldData: decayData.second)
-                fTotalYield += energyYieldData.second * radioactiveDaughter->fBranchingRatio;
-
-    // --- Normalize the probabilities and record the cumulative probabilities --- //
-    G4double cumulativeProbability = 0.;
-    fNormalizedDecayData_Vector.clear();
-    // Itself
-    for(const auto& decayData: fDecayDataInteresting)
-        for(const auto& energyYieldData: decayData.second)
+    // The same setting (e.g. the same source in all threads) shares a table
+    fSamplingTable = NuclideLibrary::GetInstance()->GetSamplingTable(
+                GetSamplingTableKey(), [this]() { return BuildSamplingTable(); });
+    fNormalized = true;
+}
+
+G4String RadioNuclide::GetSamplingTableKey() const
+{
+    std::ostringstream oss;
+    oss.precision(std::numeric_limits<G4double>::max_digits10);
+
+    auto addSetting = [&oss](const RadioNuclide* radioNuclide)
+    {
+        oss << radioNuclide->fDecayDataKey << "*" << radioNuclide->fBranchingRatio;
+        for(const auto& interestingRadiation: radioNuclide->fInterestingRadiation_Map)
         {
-            DecayProduct decayProduct{RadioNuclide::ICode2G4ParticleName(decayData.first), energyYieldData.first};
-            fNormalizedDecayData_Vector.push_back(
-                        std::make_pair(cumulativeProbability += energyYieldData.second / fTotalYield, decayProduct)
-                        );
+            oss << ";" << static_cast<G4int>(interestingRadiation.first) << ">" << interestingRadiation.second;
+            auto yieldThreshold = radioNuclide->fYieldThreshold_Map.find(interestingRadiation.first);
+            if(yieldThreshold!=radioNuclide->fYieldThreshold_Map.end())
+                oss << "," << yieldThreshold->second;
         }
-    // Its radioactive daughters
-    for(const auto& radioactiveDaughter: fRadioactiveDaughters)
-        for(const auto& decayData: radioactiveDaughter->fDecayDataInteresting)
-            for(const auto& energyYieldData: decayData.second)
-            {
-                DecayProduct decayProduct{RadioNuclide::ICode2G4ParticleName(decayData.first), energyYieldData.first};
-                fNormalizedDecayData_Vector.push_back(
-                            std::make_pair(cumulativeProbability += energyYieldData.second * radioactiveDaughter->fBranchingRatio / fTotalYield, decayProduct)
-                            );
-            }
+    };
 
-    fNormalized = true;
+    addSetting(this);
+    for(const auto& radioactiveDaughter: fRadioactiveDaughters)
+    {
+        oss << "|";
+        addSetting(radioactiveDaughter);
+    }
+    return oss.str();
 }
 
-RadioNuclide::DecayProduct RadioNuclide::SampleDecayProduct(G4double& particleWeight)
+RadioNuclide::SamplingTable RadioNuclide::BuildSamplingTable() const
 {
-    if(!fNormalized) Normalize();
+    SamplingTable samplingTable;
+
+    // --- Radiations of interest (itself & its radioactive daughters, weighted by the branching ratios) --- //
+    std::vector< std::tuple<DecayData, G4double, const InverseCDFTable*> > decayDataInteresting_Vector;
+    decayDataInteresting_Vector.push_back(std::make_tuple(GetDecayDataInteresting(), 1., fBetaSpectrum));
+    for(const auto& radioactiveDaughter: fRadioactiveDaughters)
+        decayDataInteresting_Vector.push_back(
+                    std::make_tuple(radioactiveDaughter->GetDecayDataInteresting(), radioactiveDaughter->fBranchingRatio,
+                                    radioactiveDaughter->fBetaSpectrum));
 
-    particleWeight *= fTotalYield;
+    // --- Calculate total yield --- //
+    samplingTable.totalYield = 0.;
+    for(const auto& decayDataInteresting: decayDataInteresting_Vector)
+        for(const auto& decayData: std::get<0>(decayDataInteresting))
+            for(const auto& energyYieldData: decayData.second)
+                samplingTable.totalYield += energyYieldData.second * std::get<1>(decayDataInteresting);
+
+    // --- Normalize the probabilities, with the particle definitions resolved once --- //
+    auto particleTable = G4ParticleTable::GetParticleTable();
+    for(const auto& decayDataInteresting: decayDataInteresting_Vector)
+        for(const auto& decayData: std::get<0>(decayDataInteresting))
+        {
+            auto particle = particleTable->FindParticle(RadioNuclide::ICode2G4ParticleName(decayData.first));
+            G4double ratio = std::get<1>(decayDataInteresting);
+
+            // Beta particles with a spectrum: a decay product of the total yield, sampled from the spectrum
+            // (the spectrum of the nuclide, covering both B+ and B- if both are emitted)
+            const InverseCDFTable* spectrum = std::get<2>(decayDataInteresting);
+            if(spectrum && !spectrum->GetQuantiles().empty() &&
+               (decayData.first==Radiation::BetaPlus || decayData.first==Radiation::BetaMinus))
+            {
+                G4double yield = 0., meanEnergy = 0.;
+                for(const auto& energyYieldData: decayData.second)
+                {
+                    yield += energyYieldData.second;
+                    meanEnergy += energyYieldData.first * energyYieldData.second;
+                }
+                if(yield <= 0.) continue;
+
+                samplingTable.decayProducts.push_back({particle, meanEnergy / yield, spectrum});
+                samplingTable.probabilities.push_back(yield * ratio / samplingTable.totalYield);
+                continue;
+            }
+
+            for(const auto& energyYieldData: decayData.second)
+            {
+                samplingTable.decayProducts.push_back({particle, energyYieldData.first, nullptr});
+                samplingTable.probabilities.push_back(energyYieldData.second * ratio / samplingTable.totalYield);
+            }
+        }
 
-    G4double rnd = G4UniformRand();
-    size_t i = 0;
-    while(rnd>std::get<0>(fNormalizedDecayData_Vector.at(i))) ++i;
+    if(samplingTable.decayProducts.empty())
+        G4Exception("RadioNuclide::BuildSamplingTable()", "", FatalErrorInArgument,
+            G4String("      no radiation of interest for '" + fRadioNuclideName + "'").c_str());
 
-    return std::get<1>(fNormalizedDecayData_Vector.at(i));
+    samplingTable.aliasTable = AliasTable(samplingTable.probabilities);
+    return samplingTable;
 }
 
 G4String RadioNuclide::ICode2G4ParticleName(Radiation radiation)
@@ -252,3 +478,98 @@ G4String RadioNuclide::ICode2G4ParticleName(Radiation radiation)
         return "geantino"; // not supported
     }
 }
+
+RadioNuclide* CreateRadioNuclide(const G4String& radioNuclideName,
+                                 const std::vector<RadioNuclide::Radiation>& radiationTypes)
+{
+    RadioNuclide* radioNuclide = nullptr;
+
+    // --- Predefined sources (photons only by default, X rays above 1 keV & 1e-3 yield) --- //
+    const std::vector<RadioNuclide::Radiation> photons =
+            {RadioNuclide::Radiation::Gamma,
+             RadioNuclide::Radiation::Xray,
+             RadioNuclide::Radiation::AnnihilationPhoton};
+    const auto& presetRadiationTypes = radiationTypes.empty() ? photons : radiationTypes;
+    auto setPresetRadiations = [&presetRadiationTypes](RadioNuclide* presetNuclide)
+    {
+        presetNuclide->AddInterestingRadiation(presetRadiationTypes);
+        presetNuclide->SetRadiationEnergyThreshold(RadioNuclide::Radiation::Xray, 1.*keV);
+        presetNuclide->SetRadiationYieldThreshold(RadioNuclide::Radiation::Xray, 1e-3);
+    };
+
+    if(radioNuclideName=="Co60p")
+        radioNuclide = new RadioNuclide("Co-60", "nuclides/Co-60.RAD");
+    else if(radioNuclideName=="Cs137p")
+    {
+        radioNuclide = new RadioNuclide("Cs-137", "nuclides/Cs-137.RAD");
+
+        auto ba137m = new RadioNuclide("Ba-137m", "nuclides/Ba-137m.RAD", 9.440e-1);
+        setPresetRadiations(ba137m);
+        radioNuclide->AddRadioactiveDaughter(ba137m);
+    }
+    else if(radioNuclideName=="Ir192p")
+        radioNuclide = new RadioNuclide("Ir-192", "nuclides/Ir-192.RAD");
+
+    if(radioNuclide)
+    {
+        setPresetRadiations(radioNuclide);
+        return radioNuclide;
+    }
+
+    // --- ICRP107 database: "Sr-90", or "Sr-90+" with its decay chain in equilibrium --- //
+    G4String nuclideName = radioNuclideName;
+    G4bool withDecayChain = !nuclideName.empty() && nuclideName.back()=='+';
+    if(withDecayChain) nuclideName.pop_back();
+
+    auto library = NuclideLibrary::GetInstance();
+    auto record = library->GetICRP107Nuclide(nuclideName);
+    if(!record) return nullptr;
+
+    // All radiations supported by default
+    std::vector<RadioNuclide::Radiation> databaseRadiationTypes = radiationTypes;
+    if(databaseRadiationTypes.empty())
+        for(G4int iCode = 1; iCode <= 11; ++iCode)
+            if(iCode!=9 && iCode!=10) // alpha recoil nuclei & fission fragments
+                databaseRadiationTypes.push_back(static_cast<RadioNuclide::Radiation>(iCode));
+
+    auto getBetaSpectrum = [](const NuclideLibrary::NuclideRecord* nuclideRecord) -> const InverseCDFTable*
+    { return nuclideRecord->betaSpectrum.GetQuantiles().empty() ? nullptr : &nuclideRecord->betaSpectrum; };
+
+    radioNuclide = new RadioNuclide(radioNuclideName, &record->decayData, getBetaSpectrum(record));
+    radioNuclide->AddInterestingRadiation(databaseRadiationTypes);
+    if(!withDecayChain) return radioNuclide;
+
+    // Descendants with the branching fractions multiplied along the chain (summed over the branches reaching them)
+    std::vector< std::pair<G4String, G4double> > descendants;
+    std::vector< std::pair<const NuclideLibrary::NuclideRecord*, G4double> > stack = {std::make_pair(record, 1.)};
+    while(!stack.empty())
+    {
+        auto parent = stack.back();
+        stack.pop_back();
+        for(const auto& daughter: parent.first->daughters)
+        {
+            auto daughterRecord = library->GetICRP107Nuclide(daughter.first);
+            if(!daughterRecord || daughter.first==nuclideName) continue;
+
+            G4double ratio = parent.second * daughter.second;
+            auto descendant = std::find_if(descendants.begin(), descendants.end(),
+                [&daughter](const std::pair<G4String, G4double>& d) { return d.first==daughter.first; });
+            if(descendant==descendants.end())
+                descendants.push_back(std::make_pair(daughter.first, ratio));
+            else
+                descendant->second += ratio;
+            stack.push_back(std::make_pair(daughterRecord, ratio));
+        }
+    }
+
+    for(const auto& descendant: descendants)
+    {
+        auto descendantRecord = library->GetICRP107Nuclide(descendant.first);
+        auto daughter = new RadioNuclide(descendant.first, &descendantRecord->decayData,
+                                         getBetaSpectrum(descendantRecord), descendant.second);
+        daughter->AddInterestingRadiation(databaseRadiationTypes);
+        radioNuclide->AddRadioactiveDaughter(daughter);
+    }
+
+    return radioNuclide;
+}
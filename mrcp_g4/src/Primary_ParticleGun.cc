@@ -1,8 +1,18 @@
 #include "Primary_ParticleGun.hh"
 #include "TETModelStore.hh"
+#include "EventInformation.hh"
+#include "NuclideLibrary.hh"
+#include "SilhouetteSampler.hh"
+#include "MRCPProtQCalculator.hh"
+
+#include "G4RunManager.hh"
+#include "G4UIcommand.hh"
+
+#include <filesystem>
 
 Primary_ParticleGun::Primary_ParticleGun()
-: G4VUserPrimaryGeneratorAction()
+: G4VUserPrimaryGeneratorAction(), fRadioNuclide(nullptr), fSpectrum(nullptr), fPositionSampling("roundRobin"),
+  fVolumeSampler(nullptr), fIrradiationGeometry(nullptr)
 {
     fPrimary = new G4ParticleGun();
 
@@ -10,14 +20,75 @@ Primary_ParticleGun::Primary_ParticleGun()
     fMessenger = new G4GenericMessenger(this, "/gun/");
 
     auto& angleBiasingCmd =
-            fMessenger->DeclareProperty("angleBiasing", fAngleBiasingPVName, "Bias the source direction to a physical volume.");
+            fMessenger->DeclareProperty("angleBiasing", fAngleBiasingPVName,
+                "Bias the source direction to a physical volume (cone to its bounding box), "
+                "or to the silhouette of the phantom's convex hull (Silhouette).");
     angleBiasingCmd.SetParameterName("physicalVolume", true);
     angleBiasingCmd.SetDefaultValue("");
 
     auto& radioNuclideCmd =
-            fMessenger->DeclareMethod("radioNuclide", &Primary_ParticleGun::SetRadioNuclide, "Co60p, Cs137p, Ir192p");
+            fMessenger->DeclareMethod("radioNuclide", &Primary_ParticleGun::SetRadioNuclide,
+                "Co60p, Cs137p, Ir192p, or a nuclide of /gun/nuclideDatabase (e.g. I-131, Sr-90+ with its decay chain); "
+                "none (empty) for /gun/particle & /gun/energy");
     radioNuclideCmd.SetParameterName("radioNuclideName", true);
     radioNuclideCmd.SetDefaultValue("");
+
+    // Tabulated energy spectrum
+    auto& spectrumCmd =
+            fMessenger->DeclareMethod("spectrum", &Primary_ParticleGun::SetSpectrum,
+                "Energy spectrum file of /gun/particle (rows of 'energy probability' for lines or "
+                "'lowerEdge upperEdge probability' for bins, optional 'unit keV'; replaces the nuclide); "
+                "none (empty) for /gun/energy");
+    spectrumCmd.SetParameterName("spectrumFilePath", true);
+    spectrumCmd.SetDefaultValue("");
+
+    // ICRP107 nuclide database
+    auto& nuclideDatabaseCmd =
+            fMessenger->DeclareMethod("nuclideDatabase", &Primary_ParticleGun::SetNuclideDatabase,
+                "Load the ICRP107 database (directory of ICRP-07.NDX, ICRP-07.RAD & ICRP-07.BET).");
+    nuclideDatabaseCmd.SetParameterName("databasePath", false);
+
+    auto& radiationTypesCmd =
+            fMessenger->DeclareMethod("radiationTypes", &Primary_ParticleGun::SetRadiationTypes,
+                "Radiations to sample, by ICODE (e.g. 1 2 3 for photons), or all (default: photons for the predefined sources, all for the database).");
+    radiationTypesCmd.SetParameterName("iCodes", false);
+
+    // Multiple source positions in a run (a result per position)
+    auto& addPositionCmd =
+            fMessenger->DeclareMethod("addPosition", &Primary_ParticleGun::AddPosition,
+                "Add a source position (replaces /gun/position). Usage: addPosition x y z unit [weight (default: 1)]");
+    addPositionCmd.SetParameterName("position", false);
+
+    fMessenger->DeclareMethod("clearPositions", &Primary_ParticleGun::ClearPositions,
+                "Remove all source positions added by addPosition.");
+
+    auto& positionSamplingCmd =
+            fMessenger->DeclareProperty("positionSampling", fPositionSampling,
+                "Assignment of the events to the positions by event ID: roundRobin (interleaved) or stratified (consecutive blocks).");
+    positionSamplingCmd.SetParameterName("positionSampling", false);
+    positionSamplingCmd.SetCandidates("roundRobin stratified");
+
+    // Volume source in the main phantom (internal dosimetry)
+    auto& sourceOrganCmd =
+            fMessenger->DeclareMethod("sourceOrgan", &Primary_ParticleGun::SetSourceOrgan,
+                "Uniform source in an organ of the protection quantity definition (replaces the source positions).");
+    sourceOrganCmd.SetParameterName("organName", false);
+
+    auto& sourceSubModelsCmd =
+            fMessenger->DeclareMethod("sourceSubModels", &Primary_ParticleGun::SetSourceSubModels,
+                "Uniform source in subModels of the main phantom (replaces the source positions). Usage: sourceSubModels ID1 ID2 ...");
+    sourceSubModelsCmd.SetParameterName("subModelIDs", false);
+
+    fMessenger->DeclareMethod("clearSourceVolume", &Primary_ParticleGun::ClearSourceVolume,
+                "Remove the volume source (back to the source positions).");
+
+    // Standard irradiation geometries (conversion coefficients per unit fluence)
+    auto& irradiationGeometryCmd =
+            fMessenger->DeclareMethod("irradiationGeometry", &Primary_ParticleGun::SetIrradiationGeometry,
+                "ICRP 116 geometry around the main phantom: AP, PA, LLAT, RLAT, ROT or ISO (replaces /gun/position & the volume source; "
+                "removed by /gun/addPosition); none (empty) to remove. Doses are per unit fluence (Gy cm2).");
+    irradiationGeometryCmd.SetParameterName("geometryName", true);
+    irradiationGeometryCmd.SetDefaultValue("");
 }
 
 Primary_ParticleGun::~Primary_ParticleGun()
@@ -34,12 +105,52 @@ void Primary_ParticleGun::GeneratePrimaries(G4Event* anEvent)
     if(fRadioNuclide)
     {
         const auto decayProduct = fRadioNuclide->SampleDecayProduct(particleWeight);
-        fPrimary->SetParticleDefinition(G4ParticleTable::GetParticleTable()->FindParticle(decayProduct.particleName));
+        fPrimary->SetParticleDefinition(decayProduct.particle);
         fPrimary->SetParticleEnergy(decayProduct.energy);
     }
+    else if(fSpectrum)
+        fPrimary->SetParticleEnergy(fSpectrum->Sample());
+
+    if(fIrradiationGeometry)
+    {
+        // The gun position differs from the last sampled one only if set by /gun/position
+        if(fPrimary->GetParticlePosition()!=fSampledPosition && G4Threading::G4GetThreadId() <= 0)
+            G4Exception("Primary_ParticleGun::GeneratePrimaries()", "", JustWarning,
+                G4String("      /gun/position is ignored with the irradiation geometry " + fIrradiationGeometry->GetName()
+                         + " (/gun/irradiationGeometry none to remove it)").c_str());
+
+        G4ThreeVector position, direction;
+        fIrradiationGeometry->Sample(position, direction, particleWeight);
+        fSampledPosition = fPhantomRotation * position + fPhantomTranslation;
+        fPrimary->SetParticlePosition(fSampledPosition);
+        fPrimary->SetParticleMomentumDirection(fPhantomRotation * direction);
+
+        fPrimary->GeneratePrimaryVertex(anEvent);
+        anEvent->GetPrimaryVertex()->SetWeight(particleWeight);
+        return;
+    }
+
+    if(fVolumeSampler)
+    {
+        fPrimary->SetParticlePosition(fPhantomRotation * fVolumeSampler->Sample() + fPhantomTranslation);
+        fPrimary->SetParticleMomentumDirection(G4RandomDirection());
+
+        fPrimary->GeneratePrimaryVertex(anEvent);
+        anEvent->GetPrimaryVertex()->SetWeight(particleWeight);
+        return;
+    }
+
+    if(!fSourcePosition_Vector.empty())
+    {
+        size_t positionIndex = SelectPosition(anEvent);
+        fPrimary->SetParticlePosition(fSourcePosition_Vector[positionIndex].position);
+        particleWeight *= fSourcePosition_Vector[positionIndex].weight;
+        anEvent->SetUserInformation(new EventInformation(static_cast<G4int>(positionIndex)));
+    }
 
-    auto dirVec = SampleDirectionFromTo(
-                fPrimary->GetParticlePosition(), fAngleBiasingPVName, particleWeight);
+    auto dirVec = (fAngleBiasingPVName=="Silhouette") ?
+                SampleDirectionToSilhouette(fPrimary->GetParticlePosition(), "MainPhantom", "PhantomBox", particleWeight) :
+                SampleDirectionFromTo(fPrimary->GetParticlePosition(), fAngleBiasingPVName, particleWeight);
     fPrimary->SetParticleMomentumDirection(dirVec);
 
     fPrimary->GeneratePrimaryVertex(anEvent);
@@ -48,62 +159,230 @@ void Primary_ParticleGun::GeneratePrimaries(G4Event* anEvent)
 
 void Primary_ParticleGun::SetRadioNuclide(const G4String& radioNuclideName)
 {
-    if(radioNuclideName=="Co60p")
+    // No nuclide: the particle & energy of /gun/particle & /gun/energy
+    if(radioNuclideName.empty())
     {
         if(fRadioNuclide) delete fRadioNuclide;
+        fRadioNuclide = nullptr;
+        fRadioNuclideName = "";
+        return;
+    }
+
+    auto radioNuclide = CreateRadioNuclide(radioNuclideName, fRadiationTypes);
+    if(!radioNuclide)
+    {
+        G4Exception("Primary_ParticleGun::SetRadioNuclide()", "", JustWarning,
+            G4String("      unknown radionuclide '" + radioNuclideName + "' (not predefined, nor in the nuclide database)").c_str());
+        return;
+    }
+
+    if(fRadioNuclide) delete fRadioNuclide;
+    fRadioNuclide = radioNuclide;
+    fRadioNuclideName = radioNuclideName;
+    fSpectrum = nullptr;
+    fSpectrumName = "";
+}
 
-        fRadioNuclide = new RadioNuclide("Co-60", "nuclides/Co-60.RAD");
-        fRadioNuclide->AddInterestingRadiation(
-                {RadioNuclide::Radiation::Gamma,
-                 RadioNuclide::Radiation::Xray,
-                 RadioNuclide::Radiation::AnnihilationPhoton}
-                );
-        fRadioNuclide->SetRadiationEnergyThreshold(RadioNuclide::Radiation::Xray, 1.*keV);
-        fRadioNuclide->SetRadiationYieldThreshold(RadioNuclide::Radiation::Xray, 1e-3);
+void Primary_ParticleGun::SetSpectrum(const G4String& spectrumFilePath)
+{
+    // No spectrum: the energy of /gun/energy
+    if(spectrumFilePath.empty() || spectrumFilePath=="none")
+    {
+        fSpectrum = nullptr;
+        fSpectrumName = "";
+        return;
+    }
 
+    // Loaded once per process (the first thread), shared by the others
+    auto spectrum = EnergySpectrum::GetSpectrum(spectrumFilePath);
+    if(!spectrum)
+    {
+        G4Exception("Primary_ParticleGun::SetSpectrum()", "", JustWarning,
+            G4String("      cannot read the energy spectrum '" + spectrumFilePath + "'").c_str());
         return;
     }
 
-    if(radioNuclideName=="Cs137p")
+    SetRadioNuclide("");
+    fSpectrum = spectrum;
+    fSpectrumName = std::filesystem::path(spectrumFilePath.c_str()).filename().string();
+
+    if(G4Threading::G4GetThreadId() <= 0)
+        G4cout << " Energy spectrum '" << spectrumFilePath << "': " << spectrum->GetNumBins() << " lines & bins, mean "
+               << spectrum->GetMeanEnergy()/MeV << " MeV" << G4endl;
+}
+
+void Primary_ParticleGun::SetNuclideDatabase(const G4String& databasePath)
+{
+    // Loaded once per process (the first thread), shared by the others
+    NuclideLibrary::GetInstance()->LoadICRP107(databasePath);
+}
+
+void Primary_ParticleGun::SetRadiationTypes(const G4String& iCodes)
+{
+    std::vector<RadioNuclide::Radiation> radiationTypes;
+    if(iCodes!="all")
     {
-        if(fRadioNuclide) delete fRadioNuclide;
+        std::istringstream iss(iCodes);
+        G4int iCode;
+        while(iss >> iCode)
+        {
+            if(iCode < 1 || iCode > 11)
+            {
+                G4Exception("Primary_ParticleGun::SetRadiationTypes()", "", JustWarning,
+                    G4String("      invalid ICODE in: " + iCodes).c_str());
+                return;
+            }
+            radiationTypes.push_back(static_cast<RadioNuclide::Radiation>(iCode));
+        }
+        if(!iss.eof() || radiationTypes.empty())
+        {
+            G4Exception("Primary_ParticleGun::SetRadiationTypes()", "", JustWarning,
+                G4String("      invalid argument: " + iCodes).c_str());
+            return;
+        }
+    }
+    fRadiationTypes = radiationTypes;
 
-        fRadioNuclide = new RadioNuclide("Cs-137", "nuclides/Cs-137.RAD");
-        fRadioNuclide->AddInterestingRadiation(
-                {RadioNuclide::Radiation::Gamma,
-                 RadioNuclide::Radiation::Xray,
-                 RadioNuclide::Radiation::AnnihilationPhoton}
-                );
-        fRadioNuclide->SetRadiationEnergyThreshold(RadioNuclide::Radiation::Xray, 1.*keV);
-        fRadioNuclide->SetRadiationYieldThreshold(RadioNuclide::Radiation::Xray, 1e-3);
-
-        auto ba137m = new RadioNuclide("Ba-137m", "nuclides/Ba-137m.RAD", 9.440e-1);
-        ba137m->AddInterestingRadiation(
-                {RadioNuclide::Radiation::Gamma,
-                RadioNuclide::Radiation::Xray,
-                RadioNuclide::Radiation::AnnihilationPhoton}
-                );
-        ba137m->SetRadiationEnergyThreshold(RadioNuclide::Radiation::Xray, 1.*keV);
-        ba137m->SetRadiationYieldThreshold(RadioNuclide::Radiation::Xray, 1e-3);
-
-        fRadioNuclide->AddRadioactiveDaughter(ba137m);
+    // Applied to the current source
+    if(fRadioNuclide) SetRadioNuclide(fRadioNuclideName);
+}
 
+void Primary_ParticleGun::AddPosition(const G4String& args)
+{
+    std::istringstream iss(args);
+    G4double x, y, z, weight(1.);
+    G4String unit;
+    iss >> x >> y >> z >> unit;
+    if(!iss.eof()) iss >> weight;
+    if(iss.fail() || weight <= 0.)
+    {
+        G4Exception("Primary_ParticleGun::AddPosition()", "", JustWarning,
+            G4String("      invalid argument: " + args).c_str());
         return;
     }
 
-    if(radioNuclideName=="Ir192p")
+    fSourcePosition_Vector.push_back({G4ThreeVector(x, y, z)*G4UIcommand::ValueOf(unit), weight});
+
+    // The positions would be ignored with the irradiation geometry
+    if(fIrradiationGeometry)
     {
-        if(fRadioNuclide) delete fRadioNuclide;
+        if(G4Threading::G4GetThreadId() <= 0)
+            G4cout << " Irradiation geometry " << fIrradiationGeometry->GetName() << " is removed by /gun/addPosition" << G4endl;
+        fIrradiationGeometry = nullptr;
+    }
+}
+
+G4String Primary_ParticleGun::GetPositionInfo(size_t positionIndex) const
+{
+    const auto& sourcePosition = fSourcePosition_Vector.at(positionIndex);
+    std::stringstream ss;
+    if(fRadioNuclide)
+        ss << fRadioNuclide->GetRadioNuclideName();
+    ss << "@" << sourcePosition.position/cm << "cm";
+    if(sourcePosition.weight!=1.)
+        ss << "*" << sourcePosition.weight;
+    return ss.str();
+}
+
+size_t Primary_ParticleGun::SelectPosition(const G4Event* anEvent) const
+{
+    G4long nPositions = static_cast<G4long>(fSourcePosition_Vector.size());
+    G4long eventID = anEvent->GetEventID();
+
+    // Stratified: the events of the run are split into consecutive blocks of (almost) equal size
+    if(fPositionSampling=="stratified")
+    {
+        G4long nEvents = G4RunManager::GetRunManager()->GetCurrentRun()->GetNumberOfEventToBeProcessed();
+        if(nEvents > 0)
+            return static_cast<size_t>(std::min(eventID * nPositions / nEvents, nPositions - 1));
+    }
+
+    return static_cast<size_t>(eventID % nPositions);
+}
+
+void Primary_ParticleGun::SetSourceOrgan(const G4String& organName)
+{
+    auto protQCalculator = MRCPProtQCalculator::GetCalculator("MainPhantom");
+    if(!protQCalculator || !protQCalculator->HasOrgan(organName))
+    {
+        G4Exception("Primary_ParticleGun::SetSourceOrgan()", "", JustWarning,
+            G4String("      no organ '" + organName + "' is defined").c_str());
+        return;
+    }
 
-        fRadioNuclide = new RadioNuclide("Ir-192", "nuclides/Ir-192.RAD");
-        fRadioNuclide->AddInterestingRadiation(
-                {RadioNuclide::Radiation::Gamma,
-                 RadioNuclide::Radiation::Xray,
-                 RadioNuclide::Radiation::AnnihilationPhoton}
-                );
-        fRadioNuclide->SetRadiationEnergyThreshold(RadioNuclide::Radiation::Xray, 1.*keV);
-        fRadioNuclide->SetRadiationYieldThreshold(RadioNuclide::Radiation::Xray, 1e-3);
+    SetSourceVolume(protQCalculator->GetOrganSubModelIDs(organName), organName);
+}
+
+void Primary_ParticleGun::SetSourceSubModels(const G4String& subModelIDs)
+{
+    std::set<G4int> subModelID_Set;
+    std::istringstream iss(subModelIDs);
+    G4int subModelID;
+    while(iss >> subModelID)
+        subModelID_Set.insert(subModelID);
+    if(!iss.eof() || subModelID_Set.empty())
+    {
+        G4Exception("Primary_ParticleGun::SetSourceSubModels()", "", JustWarning,
+            G4String("      invalid argument: " + subModelIDs).c_str());
+        return;
+    }
+
+    std::stringstream ss;
+    ss << "subModels";
+    for(const auto& id: subModelID_Set)
+        ss << "_" << id;
+    SetSourceVolume(subModelID_Set, ss.str());
+}
+
+void Primary_ParticleGun::SetSourceVolume(const std::set<G4int>& subModelIDs, const G4String& sourceVolumeName)
+{
+    // The tets are in the frame of the phantom box
+    auto phantomBox = G4PhysicalVolumeStore::GetInstance()->GetVolume("PhantomBox");
+    auto volumeSampler = TETVolumeSampler::GetSampler("MainPhantom", subModelIDs);
+    if(!phantomBox || !volumeSampler)
+    {
+        G4Exception("Primary_ParticleGun::SetSourceVolume()", "", JustWarning,
+            G4String("      no tet in '" + sourceVolumeName + "' (or the geometry is not initialized)").c_str());
+        return;
+    }
+
+    fVolumeSampler = volumeSampler;
+    fSourceVolumeName = sourceVolumeName;
+    fIrradiationGeometry = nullptr;
+    fPhantomRotation = phantomBox->GetObjectRotationValue();
+    fPhantomTranslation = phantomBox->GetObjectTranslation();
+
+    if(G4Threading::G4GetThreadId() <= 0)
+        G4cout << " Volume source '" << sourceVolumeName << "': " << volumeSampler->GetNumTets() << " tets, "
+               << volumeSampler->GetVolume()/cm3 << " cm3" << G4endl;
+}
+
+void Primary_ParticleGun::SetIrradiationGeometry(const G4String& geometryName)
+{
+    if(geometryName.empty() || geometryName=="none")
+    {
+        fIrradiationGeometry = nullptr;
+        return;
+    }
 
+    // The hull of the tets is in the frame of the phantom box
+    auto phantomBox = G4PhysicalVolumeStore::GetInstance()->GetVolume("PhantomBox");
+    auto irradiationGeometry = IrradiationGeometry::GetGeometry(geometryName, "MainPhantom");
+    if(!phantomBox || !irradiationGeometry)
+    {
+        G4Exception("Primary_ParticleGun::SetIrradiationGeometry()", "", JustWarning,
+            G4String("      unknown irradiation geometry '" + geometryName + "' (AP, PA, LLAT, RLAT, ROT, ISO), "
+                     "or the geometry is not initialized").c_str());
         return;
     }
+
+    fIrradiationGeometry = irradiationGeometry;
+    fSampledPosition = fPrimary->GetParticlePosition(); // see GeneratePrimaries()
+    ClearSourceVolume();
+    fPhantomRotation = phantomBox->GetObjectRotationValue();
+    fPhantomTranslation = phantomBox->GetObjectTranslation();
+
+    if(G4Threading::G4GetThreadId() <= 0)
+        G4cout << " Irradiation geometry " << geometryName << ": mean source plane "
+               << irradiationGeometry->GetMeanArea()/cm2 << " cm2, doses per unit fluence (Gy cm2)" << G4endl;
 }
@@ -0,0 +1,160 @@
+#include "Primary_PhaseSpace.hh"
+
+#include "G4IonTable.hh"
+#include "G4ParticleTable.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4Threading.hh"
+#ifdef G4MULTITHREADED
+#include "G4MTRunManager.hh"
+#endif
+
+#include <algorithm>
+
+extern G4int SHARD_INDEX; // From main() argument (-i)
+
+Primary_PhaseSpace::Primary_PhaseSpace()
+: G4VUserPrimaryGeneratorAction(), fNRecycles(1), fNShards(1), fFile(nullptr), fWeightScale(1.),
+  fPartitionBegin(0), fPartitionEnd(0), fCursor(0)
+{
+    // Messenger setting
+    fMessenger = new G4GenericMessenger(this, "/phsp/", "Primaries from a phase-space file");
+
+    auto& fileCmd =
+            fMessenger->DeclareMethod("file", &Primary_PhaseSpace::SetFileName,
+                "Phase-space file written by /MRCP/phsp/write.");
+    fileCmd.SetParameterName("fileName", false);
+
+    auto& recycleCmd =
+            fMessenger->DeclareProperty("recycle", fNRecycles,
+                "Number of times each particle is used in its event (at weight / N), default: 1.");
+    recycleCmd.SetParameterName("nRecycles", false);
+    recycleCmd.SetRange("nRecycles>=1");
+
+    auto& nShardsCmd =
+            fMessenger->DeclareProperty("nShards", fNShards,
+                "Number of shards (processes, MRCP -i 0 ... nShards-1) sharing the file, each reading its own records, default: 1.");
+    nShardsCmd.SetParameterName("nShards", false);
+    nShardsCmd.SetRange("nShards>=1");
+}
+
+Primary_PhaseSpace::~Primary_PhaseSpace()
+{
+    delete fMessenger;
+}
+
+void Primary_PhaseSpace::SetFileName(const G4String& fileName)
+{
+    // No primaries would give a valid-looking result of zero doses
+    auto file = PhaseSpaceFile::Open(fileName);
+    if(!file || file->GetNumRecords()==0)
+        G4Exception("Primary_PhaseSpace::SetFileName()", "", FatalException,
+            G4String("      no phase-space record in '" + fileName + "' (/phsp/file)").c_str());
+
+    fFileName = fileName;
+    fFile = nullptr; // partitioned at the next event (/phsp/nShards may be set after)
+}
+
+void Primary_PhaseSpace::OpenFile()
+{
+    if(fFileName.empty())
+        G4Exception("Primary_PhaseSpace::OpenFile()", "", FatalException,
+            "      no phase-space file (/phsp/file)");
+    fFile = PhaseSpaceFile::Open(fFileName); // checked by SetFileName()
+    if(::SHARD_INDEX < 0 || ::SHARD_INDEX >= fNShards)
+        G4Exception("Primary_PhaseSpace::OpenFile()", "", FatalException,
+            G4String("      shard index " + std::to_string(::SHARD_INDEX) + " is out of /phsp/nShards "
+                     + std::to_string(fNShards) + " (shards would replay the same records)").c_str());
+
+    // --- Partition of this thread (contiguous records) --- //
+    uint64_t nRecords = fFile->GetNumRecords();
+    uint64_t nThreads = 1;
+#ifdef G4MULTITHREADED
+    auto mtRunManager = G4MTRunManager::GetMasterRunManager();
+    if(mtRunManager && G4Threading::IsWorkerThread())
+        nThreads = std::max(mtRunManager->GetNumberOfThreads(), 1);
+#endif
+    uint64_t nPartitions = nThreads * fNShards;
+    uint64_t partitionIndex = ::SHARD_INDEX * nThreads + std::max(G4Threading::G4GetThreadId(), 0) % nThreads;
+    if(nRecords < nPartitions) // too few records to split: all partitions read all records, from different offsets
+    {
+        if(partitionIndex==0)
+            G4Exception("Primary_PhaseSpace::OpenFile()", "", JustWarning,
+                G4String("      fewer records than partitions (threads x shards) in '" + fFileName
+                         + "', the records are shared").c_str());
+        fPartitionBegin = 0;
+        fPartitionEnd = nRecords;
+        fCursor = partitionIndex % nRecords;
+    }
+    else
+    {
+        fPartitionBegin = nRecords * partitionIndex / nPartitions;
+        fPartitionEnd = nRecords * (partitionIndex + 1) / nPartitions;
+        fCursor = fPartitionBegin;
+    }
+
+    // Dose per event = dose per source history of the first stage
+    fWeightScale = 1.;
+    if(fFile->GetNumHistories() > 0)
+        fWeightScale = static_cast<G4double>(nRecords) / fFile->GetNumHistories();
+    else
+        G4Exception("Primary_PhaseSpace::OpenFile()", "", JustWarning,
+            G4String("      no source history count in '" + fFileName + "', doses are per particle").c_str());
+
+    if(G4Threading::G4GetThreadId() <= 0)
+        G4cout << " Phase-space file: " << fFileName << " (" << nRecords << " particles, "
+               << fFile->GetNumHistories() << " histories, " << nPartitions << " partitions)" << G4endl;
+}
+
+G4ParticleDefinition* Primary_PhaseSpace::FindParticle(G4int pdgCode)
+{
+    auto particle = fParticle_Map.find(pdgCode);
+    if(particle!=fParticle_Map.end()) return particle->second;
+
+    auto particleDefinition = G4ParticleTable::GetParticleTable()->FindParticle(pdgCode);
+    if(!particleDefinition && pdgCode > 1000000000) // ion (10LZZZAAAI)
+        particleDefinition = G4IonTable::GetIonTable()->GetIon(pdgCode);
+    if(!particleDefinition)
+        G4Exception("Primary_PhaseSpace::FindParticle()", "", JustWarning,
+            G4String("      unknown PDG code " + std::to_string(pdgCode) + " in the phase-space file, skipped").c_str());
+
+    fParticle_Map[pdgCode] = particleDefinition;
+    return particleDefinition;
+}
+
+void Primary_PhaseSpace::GeneratePrimaries(G4Event* anEvent)
+{
+    if(!fFile) OpenFile();
+
+    // --- Next record of the partition --- //
+    const auto& record = fFile->GetRecords()[fCursor];
+    if(++fCursor==fPartitionEnd)
+    {
+        static G4ThreadLocal G4bool warned = false;
+        if(!warned)
+            G4Exception("Primary_PhaseSpace::GeneratePrimaries()", "", JustWarning,
+                "      all records of the partition are used, reused from the beginning");
+        warned = true;
+        fCursor = fPartitionBegin;
+    }
+
+    auto particleDefinition = FindParticle(record.pdgCode);
+    if(!particleDefinition) return;
+
+    // --- The particle, recycled --- //
+    G4ThreeVector position(record.position[0]*cm, record.position[1]*cm, record.position[2]*cm);
+    G4ThreeVector direction(record.direction[0], record.direction[1], record.direction[2]);
+    G4double weight = record.weight * fWeightScale / fNRecycles;
+
+    auto vertex = new G4PrimaryVertex(position, 0.);
+    for(G4int i = 0; i < fNRecycles; ++i)
+    {
+        auto primary = new G4PrimaryParticle(particleDefinition);
+        primary->SetKineticEnergy(record.energy*MeV);
+        primary->SetMomentumDirection(direction.unit());
+        primary->SetWeight(weight);
+        vertex->SetPrimary(primary);
+    }
+    anEvent->AddPrimaryVertex(vertex);
+}
@@ -1,18 +1,34 @@
 #include "Run.hh"
-#include "MRCPProtQCalculator.hh"
+#include "TETModelStore.hh"
+#include "MRCPModel.hh"
+#include "RunMonitor.hh"
+#include "EventInformation.hh"
+#include "Primary_ParticleGun.hh"
 
-Run::Run()
-: G4Run(), fPhantomDose_HCID(-1)
+#include "Randomize.hh"
+
+#include <algorithm>
+
+Run::Run(G4int batchSize, G4bool processesEvents)
+: G4Run(), fPhantomDose_HCID(-1), fAccumulator(batchSize), fProducer(nullptr), fBatchSize(batchSize),
+  fPublishInterval(RunMonitor::GetInstance()->GetPublishInterval()), fEventsSincePublish(0)
 {
-    // --- MRCPCalculator --- //
-    mainPhantomProtQ = new MRCPProtQCalculator("MainPhantom");
+    // --- SubModel dose tally --- //
+    fMRCPModel = dynamic_cast<MRCPModel*>(TETModelStore::GetInstance()->GetTETModel("MainPhantom"));
+
+    // --- Source positions (the master of MT takes them from the workers' runs in Merge()) --- //
+    auto pga = dynamic_cast<const Primary_ParticleGun*>(G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+    if(pga)
+        for(size_t i = 0; i < pga->GetNumPositions(); ++i)
+            fPositionInfo_Vector.push_back(pga->GetPositionInfo(i));
+
+    // --- Asynchronous reduction --- //
+    if(processesEvents)
+        fProducer = TallyReducer::GetInstance()->GetProducer(G4Threading::G4GetThreadId());
 }
 
 Run::~Run()
-{
-    delete mainPhantomProtQ;
-    if(!fProtQ.empty()) fProtQ.clear();
-}
+{}
 
 void Run::RecordEvent(const G4Event* anEvent)
 {
@@ -25,45 +41,47 @@ void Run::RecordEvent(const G4Event* anEvent)
 
     auto doseMap = static_cast<G4THitsMap<G4double>*>(HCE->GetHC(fPhantomDose_HCID));
 
-    // Calculate protection quantities of this event
-    std::map<G4String, G4double> protQMap;
-    protQMap["01. WholeBodyDose"] = mainPhantomProtQ->GetWholebodyDose(doseMap);
-    protQMap["02. EffectiveDose"] = mainPhantomProtQ->GetEffectiveDose(doseMap);
-    protQMap["11. RedBoneMarrow"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::RedBoneMarrow, doseMap);
-    protQMap["12. Colon"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Colon, doseMap);
-    protQMap["13. Lungs"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Lungs, doseMap);
-    protQMap["14. Stomach"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Stomach, doseMap);
-    protQMap["15. Breast"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Breast, doseMap);
-    protQMap["16. Gonads"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Gonads, doseMap);
-    protQMap["17. Bladder"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Bladder, doseMap);
-    protQMap["18. Liver"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Liver, doseMap);
-    protQMap["19. Oesophagus"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Oesophagus, doseMap);
-    protQMap["20. Thyroid"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Thyroid, doseMap);
-    protQMap["21. BoneSurface"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::BoneSurface, doseMap);
-    protQMap["22. Brain"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Brain, doseMap);
-    protQMap["23. SalivaryGlands"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::SalivaryGlands, doseMap);
-    protQMap["24. Skin"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Skin, doseMap);
-    protQMap["25. Adrenals"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Adrenals, doseMap);
-    protQMap["26. Extrathoracic"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Extrathoracic, doseMap);
-    protQMap["27. GallBladder"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::GallBladder, doseMap);
-    protQMap["28. Heart"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Heart, doseMap);
-    protQMap["29. Kidneys"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Kidneys, doseMap);
-    protQMap["30. LymphaticNodes"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::LymphaticNodes, doseMap);
-    protQMap["31. Muscle"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Muscle, doseMap);
-    protQMap["32. OralMucosa"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::OralMucosa, doseMap);
-    protQMap["33. Pancreas"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Pancreas, doseMap);
-    protQMap["34. ProstateUterus"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::ProstateUterus, doseMap);
-    protQMap["35. SmallIntestine"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::SmallIntestine, doseMap);
-    protQMap["36. Spleen"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Spleen, doseMap);
-    protQMap["37. Thymus"] = mainPhantomProtQ->GetOrganDose(MRCPProtQCalculator::Organ::Thymus, doseMap);
-
-    // Store the quantities and their squared values
-    for(const auto& protQ: protQMap)
+    // Source position of this event, if multiple (no per-position tally for other user information)
+    auto eventInformation = dynamic_cast<const EventInformation*>(anEvent->GetUserInformation());
+    G4int positionIndex = eventInformation ? eventInformation->GetPositionIndex() : -1;
+
+    // Accumulate the dose map of this event (or hand it to the reducer thread)
+    if(fProducer)
+    {
+        fProducer->SetPositionIndex(positionIndex);
+        for(const auto& datum: *(doseMap->GetMap()))
+        {
+            G4int tallyIndex = fMRCPModel->GetDoseTallyIndex(datum.first);
+            if(tallyIndex >= 0) fProducer->Push(static_cast<size_t>(tallyIndex), *datum.second);
+        }
+        fProducer->EndOfEvent();
+    }
+    else
+    {
+        fAccumulator.SetPositionIndex(positionIndex);
+        for(const auto& datum: *(doseMap->GetMap()))
+        {
+            G4int tallyIndex = fMRCPModel->GetDoseTallyIndex(datum.first);
+            if(tallyIndex >= 0) fAccumulator.AddDose(static_cast<size_t>(tallyIndex), *datum.second);
+        }
+        fAccumulator.EndOfEvent();
+    }
+
+    // Publish the partial tally to the run monitor (by the reducer if asynchronous),
+    // and stop the event loop if requested
+    if(fPublishInterval > 0 && ++fEventsSincePublish >= fPublishInterval)
     {
-        fProtQ[protQ.first].first += protQ.second;
-        fProtQ[protQ.first].second += protQ.second * protQ.second;
+        auto runMonitor = RunMonitor::GetInstance();
+        if(!fProducer)
+            runMonitor->Publish(G4Threading::G4GetThreadId(), GetTally(), G4Random::getTheEngine()->put());
+        fEventsSincePublish = 0;
+
+        if(runMonitor->IsStopRequested())
+            G4RunManager::GetRunManager()->AbortRun(true);
     }
 
+    fLastEventTime = std::chrono::steady_clock::now();
+
     G4Run::RecordEvent(anEvent);
 }
 
@@ -71,11 +89,29 @@ void Run::Merge(const G4Run* aRun)
 {
     const Run* localRun = static_cast<const Run*>(aRun);
 
-    for(const auto& protQ: localRun->GetProtQ())
-    {
-        this->fProtQ[protQ.first].first += std::get<0>(protQ.second);
-        this->fProtQ[protQ.first].second += std::get<1>(protQ.second);
-    }
+    fAccumulator.Add(localRun->GetTally());
+    if(localRun->GetNumberOfEvent() > 0)
+        fThreadEndTime_Vector.push_back(localRun->fLastEventTime);
+    if(fPositionInfo_Vector.empty())
+        fPositionInfo_Vector = localRun->fPositionInfo_Vector;
 
     G4Run::Merge(aRun);
 }
+
+RunTally Run::GetTally() const
+{
+    if(fProducer) return fProducer->GetReducedTally();
+    return fAccumulator.GetTally();
+}
+
+std::pair<G4double, G4double> Run::GetTailIdleTime() const
+{
+    if(fThreadEndTime_Vector.empty()) return std::make_pair(0., 0.);
+
+    auto minMax = std::minmax_element(fThreadEndTime_Vector.begin(), fThreadEndTime_Vector.end());
+    G4double idleTime = 0.;
+    for(const auto& threadEndTime: fThreadEndTime_Vector)
+        idleTime += std::chrono::duration<G4double>(*minMax.second - threadEndTime).count();
+
+    return std::make_pair(idleTime, std::chrono::duration<G4double>(*minMax.second - *minMax.first).count());
+}
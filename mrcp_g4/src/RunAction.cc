@@ -1,35 +1,173 @@
 #include "RunAction.hh"
 #include "Run.hh"
 #include "Primary_ParticleGun.hh"
+#include "Primary_PhaseSpace.hh"
+#include "TETModelStore.hh"
+#include "MRCPModel.hh"
+#include "MRCPProtQCalculator.hh"
+#include "RunMonitor.hh"
+#include "TallyReducer.hh"
+#include "SAFProducer.hh"
+
+#include "G4UImanager.hh"
+#include "Randomize.hh"
 
 extern std::filesystem::path OUTPUT_FILENAME; // From main() argument (-o)
+extern G4long MASTER_SEED; // From main() argument (-s)
+extern G4int SHARD_INDEX;  // From main() argument (-i)
 
 G4String RunAction::fPrimaryInfo;
+G4String RunAction::fResumedSourceInfo;
+G4bool RunAction::fOutputGood = false;
 
 RunAction::RunAction()
-: G4UserRunAction(), fRunTimer(nullptr)
+: G4UserRunAction(), fRunTimer(nullptr), fPrintHeader(true), fBatchSize(0), fCheckpointInterval(600.*s), fSnapshotInterval(10.*s),
+  fRunTime(0.), fEventRate(0.), fAsyncReduction(0), fChainEventsToBeProcessed(0), fNChainSubRuns(0), fChainRunTime(0.)
 {
+    // Messenger setting
+    fMessenger = new G4GenericMessenger(this, "/MRCP/run/", "MRCP run control");
+
+    auto& batchSizeCmd =
+            fMessenger->DeclareProperty("batchSize", fBatchSize,
+                "Uncertainty by batch statistics. 0: history-by-history, N: N events per batch, -1: a batch per thread.");
+    batchSizeCmd.SetParameterName("batchSize", true);
+    batchSizeCmd.SetDefaultValue("0");
+    batchSizeCmd.SetRange("batchSize>=-1");
+
+    // Early termination (run monitor settings are shared, so they are set on the master only)
+    auto& targetErrorCmd =
+            fMessenger->DeclareMethod("targetError", &RunAction::SetTargetError,
+                "Stop the run when the relative error of the protection quantity reaches the target. "
+                "Usage: targetError <protQ name or label> <relative error> (0 to remove).");
+    targetErrorCmd.SetParameterName("targetError", false);
+    targetErrorCmd.SetToBeBroadcasted(false);
+
+    fMessenger->DeclareMethod("clearTargetErrors", &RunAction::ClearTargetErrors,
+                "Remove all target relative errors.").SetToBeBroadcasted(false);
+
+    auto& timeLimitCmd =
+            fMessenger->DeclareMethodWithUnit("timeLimit", "s", &RunAction::SetTimeLimit,
+                "Stop the run when the wall-clock time exceeds the limit (0 for no limit).");
+    timeLimitCmd.SetParameterName("timeLimit", false);
+    timeLimitCmd.SetRange("timeLimit>=0.");
+    timeLimitCmd.SetToBeBroadcasted(false);
+
+    auto& publishIntervalCmd =
+            fMessenger->DeclareMethod("publishInterval", &RunAction::SetPublishInterval,
+                "Number of events between partial tallies sent by each thread to the run monitor.");
+    publishIntervalCmd.SetParameterName("publishInterval", false);
+    publishIntervalCmd.SetRange("publishInterval>0");
+    publishIntervalCmd.SetToBeBroadcasted(false);
+
+    // Checkpoint & restart
+    auto& checkpointCmd =
+            fMessenger->DeclareMethod("checkpoint", &RunAction::SetCheckpoint,
+                "Write checkpoints of the run to the file (empty to disable).");
+    checkpointCmd.SetParameterName("checkpoint", true);
+    checkpointCmd.SetDefaultValue("");
+    checkpointCmd.SetToBeBroadcasted(false);
+
+    auto& checkpointIntervalCmd =
+            fMessenger->DeclareMethodWithUnit("checkpointInterval", "s", &RunAction::SetCheckpointInterval,
+                "Wall-clock time between checkpoints.");
+    checkpointIntervalCmd.SetParameterName("checkpointInterval", false);
+    checkpointIntervalCmd.SetRange("checkpointInterval>0.");
+    checkpointIntervalCmd.SetToBeBroadcasted(false);
+
+    auto& resumeCmd =
+            fMessenger->DeclareMethod("resume", &RunAction::Resume,
+                "Resume the run from the checkpoint file (source & physics must be set as before).");
+    resumeCmd.SetParameterName("checkpoint", false);
+    resumeCmd.SetToBeBroadcasted(false);
+
+    // Snapshots of the intermediate results
+    auto& snapshotCmd =
+            fMessenger->DeclareMethod("snapshot", &RunAction::SetSnapshot,
+                "Write snapshots of the intermediate results (JSON) to the file (empty to disable).");
+    snapshotCmd.SetParameterName("snapshot", true);
+    snapshotCmd.SetDefaultValue("");
+    snapshotCmd.SetToBeBroadcasted(false);
+
+    auto& snapshotIntervalCmd =
+            fMessenger->DeclareMethodWithUnit("snapshotInterval", "s", &RunAction::SetSnapshotInterval,
+                "Wall-clock time between snapshots.");
+    snapshotIntervalCmd.SetParameterName("snapshotInterval", false);
+    snapshotIntervalCmd.SetRange("snapshotInterval>0.");
+    snapshotIntervalCmd.SetToBeBroadcasted(false);
+
+    // Asynchronous reduction of the tallies
+    auto& asyncReductionCmd =
+            fMessenger->DeclareProperty("asyncReduction", fAsyncReduction,
+                "Reduce the tallies in separate threads, one per N workers (0: in the workers).");
+    asyncReductionCmd.SetParameterName("asyncReduction", true);
+    asyncReductionCmd.SetDefaultValue("0");
+    asyncReductionCmd.SetRange("asyncReduction>=0");
+    asyncReductionCmd.SetToBeBroadcasted(false);
+
+    // Chained sub-runs for more than 2^31-1 events
+    auto& beamOnLongCmd =
+            fMessenger->DeclareMethod("beamOnLong", &RunAction::BeamOnLong,
+                "Process events in consecutive sub-runs and report them as one result. "
+                "Usage: beamOnLong <nEvents> [subRunSize (default: 1000000000)]");
+    beamOnLongCmd.SetParameterName("beamOnLong", false);
+    beamOnLongCmd.SetToBeBroadcasted(false);
+
+    // Output files of the following runs
+    auto& outputCmd =
+            fMessenger->DeclareMethod("output", &RunAction::SetOutput,
+                "Write the results of the following runs to the file (and .subModel.out & .raw), instead of -o.");
+    outputCmd.SetParameterName("output", false);
+    outputCmd.SetToBeBroadcasted(false);
+
     if(!IsMaster()) return;
 
     fInitTimer = new G4Timer;
     fInitTimer->Start();
 
+    OpenOutputFiles();
+}
+
+void RunAction::OpenOutputFiles()
+{
     ofs.open(::OUTPUT_FILENAME.c_str());
+    fPrintHeader = true;
+
+    // SubModel dose table goes to {output name w/o extension}.subModel.out
+    auto subModelOutputFileName = ::OUTPUT_FILENAME;
+    subModelOutputFileName.replace_extension(".subModel.out");
+    ofsSubModel.open(subModelOutputFileName.c_str());
+
+    // Raw tallies (to be merged with other shards by MRCPMerge) go to {output name w/o extension}.raw
+    auto rawOutputFileName = ::OUTPUT_FILENAME;
+    rawOutputFileName.replace_extension(".raw");
+    ofsRaw.open(rawOutputFileName.c_str());
+
+    fOutputGood = ofs.is_open() && ofsSubModel.is_open() && ofsRaw.is_open();
 }
 
 RunAction::~RunAction()
 {
+    delete fMessenger;
+
     if(!IsMaster()) return;
 
     if(fInitTimer) delete fInitTimer;
     if(fRunTimer) delete fRunTimer;
 
     ofs.close();
+    ofsSubModel.close();
+    ofsRaw.close();
 }
 
 G4Run* RunAction::GenerateRun()
 {
-    return new Run;
+    // Reducer threads start before any run processing events (workers, or the master in sequential mode)
+    G4bool processesEvents = !IsMaster() || !G4Threading::IsMultithreadedApplication();
+    if(IsMaster())
+        TallyReducer::GetInstance()->Start(G4RunManager::GetRunManager()->GetNumberOfThreads(),
+                                           fAsyncReduction, fBatchSize);
+
+    return new Run(fBatchSize, processesEvents);
 //    return new G4Run;
 }
 
@@ -38,11 +176,32 @@ void RunAction::BeginOfRunAction(const G4Run* aRun)
     // --- Set print progress as 10% of total events --- //
     G4RunManager::GetRunManager()->SetPrintProgress(static_cast<G4int>(aRun->GetNumberOfEventToBeProcessed() * 0.1));
 
+    // --- Source information for checkpoints --- //
+    auto pga = dynamic_cast<const Primary_ParticleGun*>(G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+    auto phsp = dynamic_cast<const Primary_PhaseSpace*>(G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+    G4String sourceInfo = pga ? pga->GetPrimaryInfo() : (phsp ? phsp->GetPrimaryInfo() : "");
+    if(pga || phsp) RunMonitor::GetInstance()->SetSourceInfo(sourceInfo);
+
+    // --- The source of a resumed checkpoint must be the same (the workers know it only at this point) --- //
+    if((pga || phsp) && RunMonitor::GetInstance()->GetResumedTally().nEvents > 0 && sourceInfo!=fResumedSourceInfo)
+    {
+        G4Exception("RunAction::BeginOfRunAction()", "", JustWarning,
+            G4String("      source '" + sourceInfo + "' differs from the checkpoint '" + fResumedSourceInfo
+                     + "', the run is aborted").c_str());
+        G4RunManager::GetRunManager()->AbortRun();
+    }
+
     if(!IsMaster()) return;
 
     // --- Initialization ends --- //
     fInitTimer->Stop();
 
+    // --- Start watching the run (if any stopping criterion, checkpoint or snapshot is set) --- //
+    auto runMonitor = RunMonitor::GetInstance();
+    runMonitor->Start(aRun->GetRunID(),
+                      (fChainEventsToBeProcessed > 0) ? fChainEventsToBeProcessed : aRun->GetNumberOfEventToBeProcessed(),
+                      fBatchSize);
+
     // --- Run starts --- //
     fRunTimer = new G4Timer;
     fRunTimer->Start();
@@ -51,7 +210,27 @@ void RunAction::BeginOfRunAction(const G4Run* aRun)
 void RunAction::EndOfRunAction(const G4Run* aRun)
 {
     G4int nEvents = aRun->GetNumberOfEvent();
-    if(nEvents==0) return;
+    if(nEvents==0)
+    {
+        if(IsMaster())
+        {
+            RunMonitor::GetInstance()->Stop();
+            TallyReducer::GetInstance()->Stop();
+
+            // An empty sub-run (e.g. aborted) ends the chain: the sub-runs so far, carried over, are written
+            auto runMonitor = RunMonitor::GetInstance();
+            if(fChainEventsToBeProcessed > 0 && fNChainSubRuns > 0)
+            {
+                fChainEventsToBeProcessed = 0;
+                fRunTime = fChainRunTime;
+                fPrimaryInfo = fResumedSourceInfo;
+                WriteResults(runMonitor->GetResumedTally());
+                runMonitor->ClearResumedTally();
+                fPrimaryInfo.clear();
+            }
+        }
+        return;
+    }
 
     // Get source information if possible
     if(!fPrimaryInfo.size())
@@ -59,20 +238,64 @@ void RunAction::EndOfRunAction(const G4Run* aRun)
         auto pga = dynamic_cast<const Primary_ParticleGun*>(G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
         fPrimaryInfo = "NULL";
         if(pga) fPrimaryInfo = pga->GetPrimaryInfo();
+        auto phsp = dynamic_cast<const Primary_PhaseSpace*>(G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+        if(phsp) fPrimaryInfo = phsp->GetPrimaryInfo();
     }
 
+    // Phase-space records of this thread, before the master updates the file
+    PhaseSpaceWriter::GetInstance()->FlushThreadBuffer();
+
     if(!IsMaster()) return;
 
     // --- Run ends --- //
     fRunTimer->Stop();
+    fRunTime = fRunTimer->GetRealElapsed();
+    fEventRate = nEvents / fRunTime;
+    RunMonitor::GetInstance()->Stop();
+    PhaseSpaceWriter::GetInstance()->EndOfRun(nEvents);
 
     // --- Print the results --- //
     auto theRun = dynamic_cast<const Run*>(aRun);
     if(theRun)
     {
-        const auto& protQData = theRun->GetProtQ();
-        PrintDataInRows(G4cout, protQData);
-        PrintDataInCols(ofs, protQData);
+        auto tally = theRun->GetTally();
+        TallyReducer::GetInstance()->Stop(); // all events are reduced (merged) at this point
+
+        // Events of the interrupted run, if resumed
+        auto runMonitor = RunMonitor::GetInstance();
+        if(runMonitor->GetResumedTally().nEvents > 0)
+        {
+            if(fResumedSourceInfo==fPrimaryInfo)
+                tally.Add(runMonitor->GetResumedTally());
+            else
+                G4Exception("RunAction::EndOfRunAction()", "", JustWarning,
+                    G4String("      source differs from the checkpoint '" + fResumedSourceInfo
+                             + "', the checkpoint is not added").c_str());
+            runMonitor->ClearResumedTally();
+        }
+
+        fTailIdleTime = theRun->GetTailIdleTime();
+        fPositionInfos = theRun->GetPositionInfos();
+
+        // Chained sub-runs: the tally so far is carried over to the next sub-run
+        if(fChainEventsToBeProcessed > 0)
+        {
+            fChainEventsToBeProcessed -= nEvents; // a sub-run aborted early is made up by the next ones
+            fChainRunTime += fRunTime;
+            ++fNChainSubRuns;
+            if(fChainEventsToBeProcessed > 0 && !runMonitor->IsStopRequested())
+            {
+                runMonitor->SetResumedTally(tally);
+                fResumedSourceInfo = fPrimaryInfo;
+                fPrimaryInfo.clear();
+                fInitTimer->Start();
+                return;
+            }
+            fChainEventsToBeProcessed = 0;
+            fRunTime = fChainRunTime;
+        }
+
+        WriteResults(tally);
     }
 
     // --- Initialization starts for next run --- //
@@ -80,18 +303,58 @@ void RunAction::EndOfRunAction(const G4Run* aRun)
     fInitTimer->Start();
 }
 
-void RunAction::PrintDataInRows(std::ostream& out, const std::map< G4String, std::pair<G4double, G4double> >& data)
+void RunAction::WriteResults(const RunTally& tally)
+{
+    if(tally.nSamples < 2)
+        G4Exception("RunAction::WriteResults()", "", JustWarning,
+            G4String("      " + std::to_string(tally.nSamples) + " sample(s): the relative errors are undefined (-1), "
+                     "more threads or a positive /MRCP/run/batchSize are needed").c_str());
+
+    PrintDataInRows(G4cout, tally);
+    PrintDataInCols(ofs, tally);
+    PrintSubModelData(ofsSubModel, tally);
+    WriteRawData(ofsRaw, tally);
+    fOutputGood = fOutputGood && ofs.good() && ofsSubModel.good() && ofsRaw.good();
+    SAFProducer::GetInstance()->RecordRun(tally); // if producing SAFs (/MRCP/saf/run)
+    fNChainSubRuns = 0;
+}
+
+void RunAction::SetOutput(const G4String& outputFileName)
+{
+    if(!IsMaster()) return;
+
+    ofs.close();
+    ofsSubModel.close();
+    ofsRaw.close();
+
+    ::OUTPUT_FILENAME = outputFileName.c_str();
+    OpenOutputFiles();
+    if(!fOutputGood)
+        G4Exception("RunAction::SetOutput()", "", JustWarning,
+            G4String("      cannot open the output files of '" + outputFileName + "'").c_str());
+}
+
+void RunAction::PrintDataInRows(std::ostream& out, const RunTally& tally)
 {
-    G4int nEvents = G4RunManager::GetRunManager()->GetCurrentRun()->GetNumberOfEvent();
     G4int runID = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+    auto protQCalculator = MRCPProtQCalculator::GetCalculator("MainPhantom");
 
     out << std::fixed;
     out << "===========================================================================" << G4endl;
     out << " Run ID: " << runID << G4endl;
     out << " Initialization time (s): " << fInitTimer->GetRealElapsed() << G4endl;
-    out << " Running time (s): " << fRunTimer->GetRealElapsed() << G4endl;
+    out << " Running time (s): " << fRunTime << G4endl;
     out << " Number of threads: " << G4Threading::GetNumberOfRunningWorkerThreads() << G4endl;
-    out << " Number of event processed: " << nEvents << G4endl;
+    out << " Event rate (events/s): " << fEventRate << G4endl;
+    out << " Tail idle time (thread*s): " << fTailIdleTime.first
+        << " (last " << fTailIdleTime.second << " s)" << G4endl;
+    out << " Number of event processed: " << tally.nEvents << G4endl;
+    if(fNChainSubRuns > 0)
+        out << " Number of sub-runs: " << fNChainSubRuns << G4endl;
+    if(!fPositionInfos.empty())
+        out << " Number of source positions: " << fPositionInfos.size() << " (a row per position in the output file)" << G4endl;
+    out << " Uncertainty: " << GetUncertaintyInfo(tally) << G4endl;
+    out << " Termination: " << RunMonitor::GetInstance()->GetTerminationInfo() << G4endl;
     out << " Source: " << fPrimaryInfo << G4endl;
     out << "===========================================================================" << G4endl;
     out << std::scientific;
@@ -100,15 +363,13 @@ void RunAction::PrintDataInRows(std::ostream& out, const std::map< G4String, std
         << std::setw(25) << "Mean dose (Gy or Sv)"
         << std::setw(25) << "Relative error" << G4endl;
 
-    for(const auto& datum: data)
+    for(size_t i = 0; i < tally.protQSum.size(); ++i)
     {
-        G4double totalDose = std::get<0>(datum.second);
-        G4double totalSquareDose = std::get<1>(datum.second);
-        G4double meanDose = totalDose/nEvents;
-        G4double stdevDose = sqrt( (totalSquareDose/nEvents) - (meanDose * meanDose) );
-        G4double relativeError = (stdevDose/sqrt(nEvents)) / meanDose;
+        G4double meanDose, relativeError;
+        std::tie(meanDose, relativeError) =
+                GetMeanAndRelativeError(tally.protQSum[i], tally.protQSquaredSum[i], tally.nEvents, tally.nSamples);
 
-        out << std::setw(25) << datum.first
+        out << std::setw(25) << protQCalculator->GetProtQName(i)
             << std::setw(25) << meanDose/gray
             << std::setw(25) << relativeError << G4endl;
     }
@@ -116,13 +377,13 @@ void RunAction::PrintDataInRows(std::ostream& out, const std::map< G4String, std
     out << G4endl << G4endl;
 }
 
-void RunAction::PrintDataInCols(std::ostream& out, const std::map< G4String, std::pair<G4double, G4double> >& data)
+void RunAction::PrintDataInCols(std::ostream& out, const RunTally& tally)
 {
-    G4int nEvents = G4RunManager::GetRunManager()->GetCurrentRun()->GetNumberOfEvent();
     G4int runID = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+    auto protQCalculator = MRCPProtQCalculator::GetCalculator("MainPhantom");
 
     // --- Header --- //
-    if(runID==0)
+    if(fPrintHeader)
     {
         out << std::fixed
             << "RunID" << "\t"
@@ -133,36 +394,326 @@ void RunAction::PrintDataInCols(std::ostream& out, const std::map< G4String, std
             << "Source" << "\t";
 
         out << std::scientific;
-        for(const auto& datum: data)
-            out << datum.first << "(Gy|Sv)" << "\t"
-                << datum.first + "Error" << "\t";
+        for(size_t i = 0; i < tally.protQSum.size(); ++i)
+            out << protQCalculator->GetProtQName(i) << "(Gy|Sv)" << "\t"
+                << protQCalculator->GetProtQName(i) + "Error" << "\t";
 
         out << G4endl;
+        fPrintHeader = false;
     }
 
-    // --- Data --- //
-    out.precision(3);
-    out << std::fixed
-        << runID << "\t"
-        << fInitTimer->GetRealElapsed() << "\t"
-        << fRunTimer->GetRealElapsed() << "\t"
-        << G4Threading::GetNumberOfRunningWorkerThreads() << "\t"
-        << nEvents << "\t"
-        << fPrimaryInfo << "\t";
+    // --- Data (a row per source position, if multiple) --- //
+    auto printRow = [&](G4long nEvents, G4long nSamples, const G4String& sourceInfo,
+                        const G4double* protQSum, const G4double* protQSquaredSum)
+    {
+        out.precision(3);
+        out << std::fixed
+            << runID << "\t"
+            << fInitTimer->GetRealElapsed() << "\t"
+            << fRunTime << "\t"
+            << G4Threading::GetNumberOfRunningWorkerThreads() << "\t"
+            << nEvents << "\t"
+            << sourceInfo << "\t";
+
+        out.precision(6);
+        out << std::scientific;
+        for(size_t i = 0; i < tally.protQSum.size(); ++i)
+        {
+            G4double meanDose, relativeError;
+            std::tie(meanDose, relativeError) =
+                    GetMeanAndRelativeError(protQSum[i], protQSquaredSum[i], nEvents, nSamples);
+
+            out << meanDose/gray << "\t"
+                << relativeError << "\t";
+        }
 
-    out.precision(6);
-    out << std::scientific;
-    for(const auto& datum: data)
+        out << G4endl;
+    };
+
+    if(fPositionInfos.empty())
+    {
+        printRow(tally.nEvents, tally.nSamples, fPrimaryInfo, tally.protQSum.data(), tally.protQSquaredSum.data());
+        return;
+    }
+
+    size_t nProtQ = tally.protQSum.size();
+    std::vector<G4double> zero(nProtQ, 0.);
+    for(size_t i = 0; i < fPositionInfos.size(); ++i)
+    {
+        if(i < tally.GetNumPositions())
+            printRow(tally.positionNEvents[i], tally.positionNSamples[i], fPositionInfos[i],
+                     &tally.positionProtQSum[i * nProtQ], &tally.positionProtQSquaredSum[i * nProtQ]);
+        else // no event from this position
+            printRow(0, 0, fPositionInfos[i], zero.data(), zero.data());
+    }
+}
+
+void RunAction::PrintSubModelData(std::ostream& out, const RunTally& tally)
+{
+    G4int runID = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+
+    auto mrcpModel = dynamic_cast<MRCPModel*>(TETModelStore::GetInstance()->GetTETModel("MainPhantom"));
+    if(!mrcpModel) return;
+
+    out << std::fixed;
+    out << "===========================================================================" << G4endl;
+    out << " Run ID: " << runID << G4endl;
+    out << " Number of event processed: " << tally.nEvents << G4endl;
+    out << " Uncertainty: " << GetUncertaintyInfo(tally) << G4endl;
+    out << " Source: " << fPrimaryInfo << G4endl;
+    out << " RBM & BS doses by DRF are listed with IDs -10xx & -20xx" << G4endl;
+    out << "===========================================================================" << G4endl;
+
+    out << std::setw(10) << "ID"
+        << std::setw(30) << "SubModel"
+        << std::setw(16) << "Mass (g)"
+        << std::setw(20) << "Mean dose (Gy)"
+        << std::setw(20) << "Relative error" << G4endl;
+
+    for(size_t i = 0; i < tally.subModelDoseSum.size(); ++i)
     {
-        G4double totalDose = std::get<0>(datum.second);
-        G4double totalSquareDose = std::get<1>(datum.second);
-        G4double meanDose = totalDose/nEvents;
-        G4double stdevDose = sqrt( (totalSquareDose/nEvents) - (meanDose * meanDose) );
-        G4double relativeError = (stdevDose/sqrt(nEvents)) / meanDose;
+        G4int tallyID = mrcpModel->GetDoseTallyID(i);
+        G4double meanDose, relativeError;
+        std::tie(meanDose, relativeError) =
+                GetMeanAndRelativeError(tally.subModelDoseSum[i], tally.subModelDoseSquaredSum[i],
+                                        tally.nEvents, tally.nSamples);
+
+        out << std::fixed << std::setprecision(3)
+            << std::setw(10) << tallyID
+            << std::setw(30) << mrcpModel->GetDoseTallyName(i)
+            << std::setw(16) << ((tallyID > 0) ? mrcpModel->GetSubModelMass(tallyID)/g : 0.)
+            << std::scientific << std::setprecision(6)
+            << std::setw(20) << meanDose/gray
+            << std::setw(20) << relativeError << G4endl;
+    }
+
+    out << G4endl << G4endl;
+}
 
-        out << meanDose/gray << "\t"
-            << relativeError << "\t";
+void RunAction::WriteRawData(std::ostream& out, const RunTally& tally)
+{
+    auto protQCalculator = MRCPProtQCalculator::GetCalculator("MainPhantom");
+    auto mrcpModel = dynamic_cast<MRCPModel*>(TETModelStore::GetInstance()->GetTETModel("MainPhantom"));
+
+    RunTallyRecord record;
+    record.runID = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+    record.masterSeed = ::MASTER_SEED;
+    record.shardIndex = ::SHARD_INDEX;
+    record.sourceInfo = fPrimaryInfo;
+    record.batchSize = fBatchSize;
+    record.runTime = fRunTime;
+
+    for(size_t i = 0; i < protQCalculator->GetNumProtQ(); ++i)
+        record.protQNames.push_back(protQCalculator->GetProtQName(i));
+
+    for(size_t i = 0; i < mrcpModel->GetNumDoseTallies(); ++i)
+    {
+        G4int tallyID = mrcpModel->GetDoseTallyID(i);
+        record.doseTallyIDs.push_back(tallyID);
+        record.doseTallyNames.push_back(mrcpModel->GetDoseTallyName(i));
+        record.doseTallyMasses.push_back((tallyID > 0) ? mrcpModel->GetSubModelMass(tallyID)/g : 0.);
     }
+    record.positionInfos = fPositionInfos;
+
+    record.tally = tally;
+    record.Write(out);
+    out.flush();
+}
 
-    out << G4endl;
+G4String RunAction::GetUncertaintyInfo(const RunTally& tally) const
+{
+    std::stringstream ss;
+    if(fBatchSize==0)
+        ss << "history-by-history";
+    else if(fBatchSize<0)
+        ss << "batch statistics (a batch per thread, " << tally.nSamples << " batches)";
+    else
+        ss << "batch statistics (" << fBatchSize << " events per batch, " << tally.nSamples << " batches)";
+    if(tally.nSamples < 2)
+        ss << ", relative errors undefined (-1)";
+    return ss.str();
+}
+
+void RunAction::SetTargetError(const G4String& args)
+{
+    // The name may contain spaces (e.g. "02. EffectiveDose"), the last token is the target
+    auto pos = args.find_last_of(' ');
+    G4double relativeError(-1.);
+    if(pos!=std::string::npos)
+    {
+        std::istringstream iss(args.substr(pos+1));
+        iss >> relativeError;
+        if(iss.fail()) relativeError = -1.;
+    }
+    if(relativeError < 0.)
+    {
+        G4Exception("RunAction::SetTargetError()", "", JustWarning,
+            G4String("      invalid argument: " + args).c_str());
+        return;
+    }
+
+    G4String protQName = args.substr(0, args.find_last_not_of(' ', pos)+1);
+    RunMonitor::GetInstance()->SetTargetError(protQName, relativeError);
+}
+
+void RunAction::ClearTargetErrors()
+{
+    RunMonitor::GetInstance()->ClearTargetErrors();
+}
+
+void RunAction::SetTimeLimit(G4double timeLimit)
+{
+    RunMonitor::GetInstance()->SetTimeLimit(timeLimit/s);
+}
+
+void RunAction::SetPublishInterval(G4int publishInterval)
+{
+    RunMonitor::GetInstance()->SetPublishInterval(publishInterval);
+}
+
+// The run monitor must know the checkpoint before the run is generated (publish interval of Run & TallyReducer)
+void RunAction::SetCheckpoint(const G4String& checkpointFileName)
+{
+    fCheckpointFileName = checkpointFileName;
+    RunMonitor::GetInstance()->SetCheckpoint(fCheckpointFileName, fCheckpointInterval/s);
+}
+
+void RunAction::SetCheckpointInterval(G4double checkpointInterval)
+{
+    fCheckpointInterval = checkpointInterval;
+    RunMonitor::GetInstance()->SetCheckpoint(fCheckpointFileName, fCheckpointInterval/s);
+}
+
+// Likewise for the snapshots
+void RunAction::SetSnapshot(const G4String& snapshotFileName)
+{
+    fSnapshotFileName = snapshotFileName;
+    RunMonitor::GetInstance()->SetSnapshot(fSnapshotFileName, fSnapshotInterval/s);
+}
+
+void RunAction::SetSnapshotInterval(G4double snapshotInterval)
+{
+    fSnapshotInterval = snapshotInterval;
+    RunMonitor::GetInstance()->SetSnapshot(fSnapshotFileName, fSnapshotInterval/s);
+}
+
+void RunAction::Resume(const G4String& checkpointFileName)
+{
+    RunCheckpoint checkpoint;
+    std::ifstream ifs(checkpointFileName);
+    if(!ifs.is_open() || !checkpoint.Read(ifs))
+    {
+        G4Exception("RunAction::Resume()", "", JustWarning,
+            G4String("      cannot read the checkpoint '" + checkpointFileName + "'").c_str());
+        return;
+    }
+
+    // Same protection quantities & phantom (the source is checked by the threads at the beginning of the run)
+    auto protQCalculator = MRCPProtQCalculator::GetCalculator("MainPhantom");
+    auto mrcpModel = dynamic_cast<MRCPModel*>(TETModelStore::GetInstance()->GetTETModel("MainPhantom"));
+    const auto& resumedTally = checkpoint.tally;
+    if(!protQCalculator || !mrcpModel
+       || resumedTally.protQSum.size()!=protQCalculator->GetNumProtQ()
+       || resumedTally.protQSquaredSum.size()!=protQCalculator->GetNumProtQ()
+       || resumedTally.subModelDoseSum.size()!=mrcpModel->GetNumDoseTallies()
+       || resumedTally.subModelDoseSquaredSum.size()!=mrcpModel->GetNumDoseTallies()
+       || resumedTally.positionNSamples.size()!=resumedTally.GetNumPositions()
+       || resumedTally.positionProtQSum.size()!=resumedTally.GetNumPositions() * protQCalculator->GetNumProtQ()
+       || resumedTally.positionProtQSquaredSum.size()!=resumedTally.positionProtQSum.size())
+    {
+        G4Exception("RunAction::Resume()", "", JustWarning,
+            G4String("      the tallies of the checkpoint '" + checkpointFileName
+                     + "' do not match the protection quantities & phantom (or the geometry is not initialized)").c_str());
+        return;
+    }
+
+    // Sequential: the source is known before the run
+    auto pga = dynamic_cast<const Primary_ParticleGun*>(G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+    auto phsp = dynamic_cast<const Primary_PhaseSpace*>(G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction());
+    G4String sourceInfo = pga ? pga->GetPrimaryInfo() : (phsp ? phsp->GetPrimaryInfo() : checkpoint.sourceInfo);
+    if(sourceInfo!=checkpoint.sourceInfo)
+    {
+        G4Exception("RunAction::Resume()", "", JustWarning,
+            G4String("      source '" + sourceInfo + "' differs from the checkpoint '" + checkpoint.sourceInfo + "'").c_str());
+        return;
+    }
+
+    G4long nRemainingEvents = checkpoint.nEventsToBeProcessed - checkpoint.tally.nEvents;
+    if(nRemainingEvents <= 0)
+    {
+        G4Exception("RunAction::Resume()", "", JustWarning,
+            G4String("      no remaining events in the checkpoint '" + checkpointFileName + "'").c_str());
+        return;
+    }
+
+    // Same statistics as the interrupted run (broadcasted to the workers)
+    G4UImanager::GetUIpointer()->ApplyCommand("/MRCP/run/batchSize " + std::to_string(checkpoint.batchSize));
+
+    // Random engine
+    // Sequential: the engine continues exactly from the checkpoint.
+    // MT: the event seeds of the interrupted run were drawn from the master engine at its beginning,
+    //     so the restored master engine is reseeded with its own output to start an independent stream.
+    auto sequentialEngineState = checkpoint.engineStates.find(-1);
+    if(sequentialEngineState!=checkpoint.engineStates.end())
+        G4Random::getTheEngine()->get(sequentialEngineState->second);
+    else
+    {
+        G4Random::getTheEngine()->get(checkpoint.masterEngineState);
+        long seeds[3] = { static_cast<long>(G4UniformRand() * 2147483647.) + 1,
+                          static_cast<long>(checkpoint.tally.nEvents % 2147483647) + 1, 0 };
+        G4Random::setTheSeeds(seeds);
+    }
+
+    RunMonitor::GetInstance()->SetResumedTally(checkpoint.tally);
+    fResumedSourceInfo = checkpoint.sourceInfo;
+
+    G4cout << " Resuming from '" << checkpointFileName << "': "
+           << checkpoint.tally.nEvents << " of " << checkpoint.nEventsToBeProcessed << " events done" << G4endl;
+    if(nRemainingEvents > kMaxSubRunSize)
+        RunChain(nRemainingEvents, kDefaultSubRunSize);
+    else
+        G4RunManager::GetRunManager()->BeamOn(static_cast<G4int>(nRemainingEvents));
+}
+
+void RunAction::BeamOnLong(const G4String& args)
+{
+    std::istringstream iss(args);
+    G4long nEvents(0), subRunSize(kDefaultSubRunSize);
+    iss >> nEvents;
+    if(!iss.eof()) iss >> subRunSize;
+    if(iss.fail() || nEvents <= 0 || subRunSize <= 0 || subRunSize > kMaxSubRunSize)
+    {
+        G4Exception("RunAction::BeamOnLong()", "", JustWarning,
+            G4String("      invalid argument: " + args).c_str());
+        return;
+    }
+
+    RunChain(nEvents, subRunSize);
+}
+
+void RunAction::RunChain(G4long nEvents, G4long subRunSize)
+{
+    // Physics & geometry stay initialized between the sub-runs.
+    // EndOfRunAction() carries the tally over and prints once after the last sub-run.
+    fChainEventsToBeProcessed = nEvents;
+    fNChainSubRuns = 0;
+    fChainRunTime = 0.;
+
+    while(fChainEventsToBeProcessed > 0)
+    {
+        G4long nEventsLeft = fChainEventsToBeProcessed;
+        G4RunManager::GetRunManager()->BeamOn(static_cast<G4int>(std::min(nEventsLeft, subRunSize)));
+        if(fChainEventsToBeProcessed==nEventsLeft) break; // no event processed
+    }
+    fChainEventsToBeProcessed = 0;
+
+    // A sub-run that could not start (no EndOfRunAction) leaves the carried tally unwritten
+    if(fNChainSubRuns > 0)
+    {
+        G4Exception("RunAction::RunChain()", "", JustWarning,
+            G4String("      the chain stopped after " + std::to_string(fNChainSubRuns)
+                     + " sub-runs without writing them").c_str());
+        RunMonitor::GetInstance()->ClearResumedTally();
+        fNChainSubRuns = 0;
+    }
 }
@@ -0,0 +1,349 @@
+#include "RunMonitor.hh"
+#include "MRCPProtQCalculator.hh"
+
+#include "G4Exception.hh"
+#include "G4RunManager.hh"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <tuple>
+
+namespace
+{
+// Writes to a temporary file and renames it, so that readers always see a complete file
+void WriteFileAtomically(const G4String& fileName, const std::function<void(std::ostream&)>& write,
+                         const char* where)
+{
+    std::filesystem::path tempFilePath = fileName + ".tmp";
+    std::ofstream ofs(tempFilePath);
+    write(ofs);
+    ofs.close();
+
+    std::error_code ec;
+    if(ofs.fail())
+        ec = std::make_error_code(std::errc::io_error);
+    else
+        std::filesystem::rename(tempFilePath, fileName.c_str(), ec);
+
+    if(ec)
+        G4Exception(where, "", JustWarning,
+            G4String("      cannot write '" + fileName + "': " + ec.message()).c_str());
+}
+
+G4String ToJSONString(const G4String& value)
+{
+    G4String str = "\"";
+    for(const auto& c: value)
+    {
+        if(c=='"' || c=='\\') str += '\\';
+        str += c;
+    }
+    return str + "\"";
+}
+}
+
+RunMonitor::RunMonitor()
+: fTimeLimit(0.), fPublishInterval(10000), fCheckInterval(1.), fCheckpointInterval(600.), fSnapshotInterval(10.),
+  fRunID(0), fBatchSize(0), fNEventsToBeProcessed(0), fMonitorRunning(false), fStopRequested(false)
+{}
+
+void RunMonitor::SetTargetError(const G4String& protQName, G4double relativeError)
+{
+    if(relativeError <= 0.)
+        fTargetErrors.erase(protQName);
+    else
+        fTargetErrors[protQName] = relativeError;
+}
+
+void RunMonitor::Start(G4int runID, G4long nEventsToBeProcessed, G4int batchSize)
+{
+    // A publish slot per thread (workers are not running at this point)
+    fPublishSlots.clear();
+    G4int nThreads = G4RunManager::GetRunManager()->GetNumberOfThreads();
+    for(G4int i = 0; i <= nThreads; ++i)
+        fPublishSlots.emplace_back(new PublishSlot);
+
+    fStopRequested = false;
+    fTerminationInfo = "completed";
+    fStartTime = std::chrono::steady_clock::now();
+    fLastCheckpointTime = fStartTime;
+    fLastSnapshotTime = fStartTime;
+
+    fRunID = runID;
+    fNEventsToBeProcessed = nEventsToBeProcessed;
+    fBatchSize = batchSize;
+    fMasterEngineState = G4Random::getTheEngine()->put();
+
+    if(!IsActive()) return;
+
+    fMonitorRunning = true;
+    fMonitorThread = std::thread(&RunMonitor::MonitorLoop, this);
+}
+
+void RunMonitor::Stop()
+{
+    if(!fMonitorThread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(fMonitorMutex);
+        fMonitorRunning = false;
+    }
+    fMonitorCV.notify_all();
+    fMonitorThread.join();
+}
+
+void RunMonitor::SetSourceInfo(const G4String& sourceInfo)
+{
+    std::lock_guard<std::mutex> lock(fSourceInfoMutex);
+    fSourceInfo = sourceInfo;
+}
+
+void RunMonitor::Publish(G4int threadID, const RunTally& tally, const std::vector<unsigned long>& engineState)
+{
+    size_t slotIndex = static_cast<size_t>(threadID + 1);
+    if(slotIndex >= fPublishSlots.size()) return;
+
+    // Fill the back buffer, then make it the middle one
+    auto& slot = *fPublishSlots[slotIndex];
+    auto& partialTally = slot.buffers[slot.back];
+    partialTally.tally = tally;
+    partialTally.engineState = engineState;
+    slot.back = slot.middle.exchange(slot.back | kUpdated, std::memory_order_acq_rel) & ~kUpdated;
+}
+
+void RunMonitor::CollectPartialTallies()
+{
+    // Take the latest published buffers as the front ones
+    for(auto& slot: fPublishSlots)
+    {
+        if(slot->middle.load(std::memory_order_acquire) & kUpdated)
+            slot->front = slot->middle.exchange(slot->front, std::memory_order_acq_rel) & ~kUpdated;
+    }
+}
+
+RunTally RunMonitor::GetMergedTally() const
+{
+    RunTally mergedTally = fResumedTally;
+    for(const auto& slot: fPublishSlots)
+    {
+        const auto& partialTally = slot->buffers[slot->front].tally;
+        if(partialTally.nEvents==0) continue;
+
+        if(mergedTally.protQSum.empty())
+            mergedTally.Resize(partialTally.protQSum.size(), partialTally.subModelDoseSum.size());
+        mergedTally.Add(partialTally);
+    }
+    return mergedTally;
+}
+
+void RunMonitor::MonitorLoop()
+{
+    std::unique_lock<std::mutex> lock(fMonitorMutex);
+    while(fMonitorRunning)
+    {
+        fMonitorCV.wait_for(lock, std::chrono::duration<G4double>(fCheckInterval));
+        if(!fMonitorRunning || fStopRequested) continue;
+
+        auto now = std::chrono::steady_clock::now();
+        G4double elapsedTime = std::chrono::duration<G4double>(now - fStartTime).count();
+
+        CollectPartialTallies();
+        auto mergedTally = GetMergedTally();
+
+        // Checkpoint
+        if(!fCheckpointFileName.empty() &&
+           std::chrono::duration<G4double>(now - fLastCheckpointTime).count() >= fCheckpointInterval)
+        {
+            WriteCheckpoint(mergedTally);
+            fLastCheckpointTime = now;
+        }
+
+        // Wall-clock budget
+        if(fTimeLimit > 0. && elapsedTime >= fTimeLimit)
+        {
+            std::stringstream ss;
+            ss << "time limit (" << fTimeLimit << " s) reached";
+            fTerminationInfo = ss.str();
+            fStopRequested = true;
+        }
+
+        // Target relative errors
+        if(!fStopRequested && CheckConvergence(mergedTally))
+            fStopRequested = true;
+
+        // Snapshot (with the time spent by this monitor cycle)
+        if(!fSnapshotFileName.empty() &&
+           std::chrono::duration<G4double>(now - fLastSnapshotTime).count() >= fSnapshotInterval)
+        {
+            G4double monitorTime =
+                std::chrono::duration<G4double>(std::chrono::steady_clock::now() - now).count();
+            WriteSnapshot(mergedTally, elapsedTime, monitorTime);
+            fLastSnapshotTime = now;
+        }
+    }
+}
+
+G4bool RunMonitor::CheckConvergence(const RunTally& tally)
+{
+    if(fTargetErrors.empty() || tally.nSamples < 2) return false;
+
+    auto protQCalculator = MRCPProtQCalculator::GetCalculator("MainPhantom");
+
+    std::stringstream ss;
+    ss << "converged at";
+    for(const auto& targetError: fTargetErrors)
+    {
+        // Matches the full label (e.g. "02. EffectiveDose") or its name part ("EffectiveDose")
+        G4bool found = false;
+        for(size_t i = 0; i < protQCalculator->GetNumProtQ(); ++i)
+        {
+            const G4String& protQName = protQCalculator->GetProtQName(i);
+            if(protQName != targetError.first &&
+               (protQName.size() <= targetError.first.size() ||
+                protQName.substr(protQName.size() - targetError.first.size() - 1) != " " + targetError.first))
+                continue;
+
+            G4double mean, relativeError;
+            std::tie(mean, relativeError) =
+                GetMeanAndRelativeError(tally.protQSum[i], tally.protQSquaredSum[i], tally.nEvents, tally.nSamples);
+            if(relativeError < 0. || !(relativeError <= targetError.second)) return false; // also for undefined & NaN
+
+            ss << " " << targetError.first << " " << relativeError;
+            found = true;
+        }
+        if(!found) return false;
+    }
+
+    fTerminationInfo = ss.str();
+    return true;
+}
+
+void RunMonitor::WriteCheckpoint(const RunTally& mergedTally)
+{
+    if(mergedTally.nEvents==0) return;
+
+    RunCheckpoint checkpoint;
+    {
+        std::lock_guard<std::mutex> lock(fSourceInfoMutex);
+        checkpoint.sourceInfo = fSourceInfo;
+    }
+    for(size_t i = 0; i < fPublishSlots.size(); ++i)
+    {
+        const auto& partialTally = fPublishSlots[i]->buffers[fPublishSlots[i]->front];
+        if(partialTally.tally.nEvents==0 || partialTally.engineState.empty()) continue; // none if reduced asynchronously
+        checkpoint.engineStates[static_cast<G4int>(i) - 1] = partialTally.engineState;
+    }
+    checkpoint.tally = mergedTally;
+    checkpoint.batchSize = fBatchSize;
+    checkpoint.nEventsToBeProcessed = fResumedTally.nEvents + fNEventsToBeProcessed;
+    checkpoint.masterEngineState = fMasterEngineState;
+
+    WriteFileAtomically(fCheckpointFileName,
+                        [&checkpoint](std::ostream& out) { checkpoint.Write(out); },
+                        "RunMonitor::WriteCheckpoint()");
+}
+
+void RunMonitor::WriteSnapshot(const RunTally& mergedTally, G4double elapsedTime, G4double monitorTime)
+{
+    G4long nEventsDone = mergedTally.nEvents - fResumedTally.nEvents;
+    G4double eventRate = (elapsedTime > 0.) ? nEventsDone/elapsedTime : 0.;
+    G4double eta = (eventRate > 0.) ? (fNEventsToBeProcessed - nEventsDone)/eventRate : -1.;
+
+    auto protQCalculator = MRCPProtQCalculator::GetCalculator("MainPhantom");
+
+    auto write = [&](std::ostream& out)
+    {
+        out << "{\n"
+            << "  \"runID\": " << fRunID << ",\n"
+            << "  \"elapsedTime\": " << elapsedTime << ",\n"
+            << "  \"nEvents\": " << mergedTally.nEvents << ",\n"
+            << "  \"nEventsToBeProcessed\": " << fResumedTally.nEvents + fNEventsToBeProcessed << ",\n"
+            << "  \"eventRate\": " << eventRate << ",\n"
+            << "  \"eta\": " << eta << ",\n"
+            << "  \"monitorTime\": " << monitorTime << ",\n"
+            << "  \"protQ\": [";
+
+        out << std::scientific << std::setprecision(6);
+        for(size_t i = 0; i < protQCalculator->GetNumProtQ(); ++i)
+        {
+            G4double mean(0.), relativeError(0.);
+            if(mergedTally.nEvents > 0)
+                std::tie(mean, relativeError) =
+                    GetMeanAndRelativeError(mergedTally.protQSum[i], mergedTally.protQSquaredSum[i],
+                                            mergedTally.nEvents, mergedTally.nSamples);
+            if(!std::isfinite(relativeError)) relativeError = -1.;
+
+            out << (i ? "," : "") << "\n    {\"name\": " << ToJSONString(protQCalculator->GetProtQName(i))
+                << ", \"mean\": " << mean/gray
+                << ", \"relativeError\": " << relativeError << "}";
+        }
+        out << "\n  ]\n}\n";
+    };
+
+    WriteFileAtomically(fSnapshotFileName, write, "RunMonitor::WriteSnapshot()");
+}
+
+void RunCheckpoint::Write(std::ostream& out) const
+{
+    out << "# MRCP checkpoint\n";
+    out << "source " << sourceInfo << "\n";
+    out << "batchSize " << batchSize << "\n";
+    out << "nEventsToBeProcessed " << nEventsToBeProcessed << "\n";
+
+    auto writeEngineState = [&out](const std::vector<unsigned long>& engineState)
+    {
+        out << engineState.size();
+        for(const auto& value: engineState) out << " " << value;
+        out << "\n";
+    };
+    out << "masterEngine ";
+    writeEngineState(masterEngineState);
+    out << "engines " << engineStates.size() << "\n";
+    for(const auto& engineState: engineStates)
+    {
+        out << engineState.first << " ";
+        writeEngineState(engineState.second);
+    }
+
+    tally.Write(out);
+}
+
+G4bool RunCheckpoint::Read(std::istream& in)
+{
+    G4String keyword;
+
+    std::getline(in, keyword); // header
+    in >> keyword; if(keyword!="source") return false;
+    in >> std::ws;
+    std::getline(in, sourceInfo);
+    in >> keyword >> batchSize; if(keyword!="batchSize") return false;
+    in >> keyword >> nEventsToBeProcessed; if(keyword!="nEventsToBeProcessed") return false;
+
+    auto readEngineState = [&in](std::vector<unsigned long>& engineState)
+    {
+        size_t n;
+        in >> n;
+        engineState.resize(n);
+        for(auto& value: engineState) in >> value;
+    };
+    in >> keyword; if(keyword!="masterEngine") return false;
+    readEngineState(masterEngineState);
+
+    size_t nEngines;
+    in >> keyword >> nEngines; if(keyword!="engines") return false;
+    engineStates.clear();
+    for(size_t i = 0; i < nEngines; ++i)
+    {
+        G4int threadID;
+        in >> threadID;
+        readEngineState(engineStates[threadID]);
+    }
+
+    return !in.fail() && tally.Read(in);
+}
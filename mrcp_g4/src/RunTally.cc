@@ -0,0 +1,215 @@
+#include "RunTally.hh"
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+
+void RunTally::Resize(size_t nProtQ, size_t nDoseTallies)
+{
+    protQSum.assign(nProtQ, 0.);
+    protQSquaredSum.assign(nProtQ, 0.);
+    subModelDoseSum.assign(nDoseTallies, 0.);
+    subModelDoseSquaredSum.assign(nDoseTallies, 0.);
+    positionNEvents.clear();
+    positionNSamples.clear();
+    positionProtQSum.clear();
+    positionProtQSquaredSum.clear();
+}
+
+void RunTally::ResizePositions(size_t nPositions)
+{
+    positionNEvents.resize(nPositions, 0);
+    positionNSamples.resize(nPositions, 0);
+    positionProtQSum.resize(nPositions * protQSum.size(), 0.);
+    positionProtQSquaredSum.resize(nPositions * protQSum.size(), 0.);
+}
+
+void RunTally::Add(const RunTally& other)
+{
+    // Tallies of the same protection quantities & phantom only
+    if(other.protQSum.size()!=protQSum.size() || other.protQSquaredSum.size()!=protQSquaredSum.size()
+       || other.subModelDoseSum.size()!=subModelDoseSum.size() || other.subModelDoseSquaredSum.size()!=subModelDoseSquaredSum.size()
+       || other.positionNSamples.size()!=other.GetNumPositions()
+       || other.positionProtQSum.size()!=other.GetNumPositions() * protQSum.size()
+       || other.positionProtQSquaredSum.size()!=other.positionProtQSum.size())
+        G4Exception("RunTally::Add()", "", FatalException, "      tallies of different sizes");
+
+    nEvents += other.nEvents;
+    nSamples += other.nSamples;
+
+    for(size_t i = 0; i < protQSum.size(); ++i)
+    {
+        protQSum[i] += other.protQSum[i];
+        protQSquaredSum[i] += other.protQSquaredSum[i];
+    }
+
+    for(size_t i = 0; i < subModelDoseSum.size(); ++i)
+    {
+        subModelDoseSum[i] += other.subModelDoseSum[i];
+        subModelDoseSquaredSum[i] += other.subModelDoseSquaredSum[i];
+    }
+
+    // Positions without events are not tallied by other threads
+    if(other.GetNumPositions() > GetNumPositions())
+        ResizePositions(other.GetNumPositions());
+
+    for(size_t i = 0; i < other.GetNumPositions(); ++i)
+    {
+        positionNEvents[i] += other.positionNEvents[i];
+        positionNSamples[i] += other.positionNSamples[i];
+    }
+
+    for(size_t i = 0; i < other.positionProtQSum.size(); ++i)
+    {
+        positionProtQSum[i] += other.positionProtQSum[i];
+        positionProtQSquaredSum[i] += other.positionProtQSquaredSum[i];
+    }
+}
+
+void RunTally::Clear()
+{
+    nEvents = 0;
+    nSamples = 0;
+    Resize(protQSum.size(), subModelDoseSum.size()); // positions are removed
+}
+
+void RunTally::Write(std::ostream& out) const
+{
+    out << "nEvents " << nEvents << "\n"
+        << "nSamples " << nSamples << "\n";
+
+    // Doubles are written with max_digits10 so that they are read back exactly
+    out << std::scientific << std::setprecision(std::numeric_limits<G4double>::max_digits10);
+
+    out << "protQ " << protQSum.size() << "\n";
+    for(size_t i = 0; i < protQSum.size(); ++i)
+        out << protQSum[i] << " " << protQSquaredSum[i] << "\n";
+
+    out << "subModelDose " << subModelDoseSum.size() << "\n";
+    for(size_t i = 0; i < subModelDoseSum.size(); ++i)
+        out << subModelDoseSum[i] << " " << subModelDoseSquaredSum[i] << "\n";
+
+    // A line per position: nEvents, nSamples, then the sum & squared sum of each protection quantity
+    out << "positions " << GetNumPositions() << "\n";
+    for(size_t i = 0; i < GetNumPositions(); ++i)
+    {
+        out << positionNEvents[i] << " " << positionNSamples[i];
+        for(size_t j = i * protQSum.size(); j < (i+1) * protQSum.size(); ++j)
+            out << " " << positionProtQSum[j] << " " << positionProtQSquaredSum[j];
+        out << "\n";
+    }
+}
+
+G4bool RunTally::Read(std::istream& in)
+{
+    G4String keyword;
+    size_t nProtQ, nDoseTallies;
+
+    in >> keyword >> nEvents; if(keyword!="nEvents") return false;
+    in >> keyword >> nSamples; if(keyword!="nSamples") return false;
+
+    in >> keyword >> nProtQ; if(keyword!="protQ") return false;
+    protQSum.resize(nProtQ); protQSquaredSum.resize(nProtQ);
+    for(size_t i = 0; i < nProtQ; ++i)
+        in >> protQSum[i] >> protQSquaredSum[i];
+
+    in >> keyword >> nDoseTallies; if(keyword!="subModelDose") return false;
+    subModelDoseSum.resize(nDoseTallies); subModelDoseSquaredSum.resize(nDoseTallies);
+    for(size_t i = 0; i < nDoseTallies; ++i)
+        in >> subModelDoseSum[i] >> subModelDoseSquaredSum[i];
+
+    size_t nPositions;
+    in >> keyword >> nPositions; if(keyword!="positions") return false;
+    positionNEvents.clear(); positionNSamples.clear();
+    positionProtQSum.clear(); positionProtQSquaredSum.clear();
+    ResizePositions(nPositions);
+    for(size_t i = 0; i < nPositions; ++i)
+    {
+        in >> positionNEvents[i] >> positionNSamples[i];
+        for(size_t j = i * nProtQ; j < (i+1) * nProtQ; ++j)
+            in >> positionProtQSum[j] >> positionProtQSquaredSum[j];
+    }
+
+    return !in.fail();
+}
+
+void RunTallyRecord::Write(std::ostream& out) const
+{
+    // Names may contain spaces, so they are written one per line
+    out << "run " << runID << "\n"
+        << "masterSeed " << masterSeed << "\n"
+        << "shardIndex " << shardIndex << "\n"
+        << "source " << sourceInfo << "\n"
+        << "batchSize " << batchSize << "\n"
+        << std::scientific << std::setprecision(std::numeric_limits<G4double>::max_digits10)
+        << "runTime " << runTime << "\n";
+
+    out << "protQNames " << protQNames.size() << "\n";
+    for(const auto& protQName: protQNames)
+        out << protQName << "\n";
+
+    out << "doseTallies " << doseTallyIDs.size() << "\n";
+    for(size_t i = 0; i < doseTallyIDs.size(); ++i)
+        out << doseTallyIDs[i] << " " << doseTallyMasses[i] << " " << doseTallyNames[i] << "\n";
+
+    out << "positionInfos " << positionInfos.size() << "\n";
+    for(const auto& positionInfo: positionInfos)
+        out << positionInfo << "\n";
+
+    tally.Write(out);
+    out << "end\n";
+}
+
+G4bool RunTallyRecord::Read(std::istream& in)
+{
+    G4String keyword;
+    size_t n;
+
+    in >> keyword >> runID; if(keyword!="run") return false;
+    in >> keyword >> masterSeed; if(keyword!="masterSeed") return false;
+    in >> keyword >> shardIndex; if(keyword!="shardIndex") return false;
+    in >> keyword >> std::ws; if(keyword!="source") return false;
+    std::getline(in, sourceInfo);
+    in >> keyword >> batchSize; if(keyword!="batchSize") return false;
+    in >> keyword >> runTime; if(keyword!="runTime") return false;
+
+    in >> keyword >> n >> std::ws; if(keyword!="protQNames") return false;
+    protQNames.resize(n);
+    for(auto& protQName: protQNames)
+        std::getline(in, protQName);
+
+    in >> keyword >> n; if(keyword!="doseTallies") return false;
+    doseTallyIDs.resize(n); doseTallyMasses.resize(n); doseTallyNames.resize(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        in >> doseTallyIDs[i] >> doseTallyMasses[i] >> std::ws;
+        std::getline(in, doseTallyNames[i]);
+    }
+
+    in >> keyword >> n >> std::ws; if(keyword!="positionInfos") return false;
+    positionInfos.resize(n);
+    for(auto& positionInfo: positionInfos)
+        std::getline(in, positionInfo);
+
+    if(in.fail() || !tally.Read(in)) return false;
+    in >> keyword;
+    return keyword=="end";
+}
+
+G4bool RunTallyRecord::IsCompatible(const RunTallyRecord& other) const
+{
+    return runID==other.runID && sourceInfo==other.sourceInfo && batchSize==other.batchSize &&
+           protQNames==other.protQNames && doseTallyIDs==other.doseTallyIDs && positionInfos==other.positionInfos;
+}
+
+std::pair<G4double, G4double> GetMeanAndRelativeError(G4double sum, G4double squaredSum,
+                                                      G4long nEvents, G4long nSamples)
+{
+    // Per-history (or per-batch-mean, weighted by batch size) variance over the number of samples
+    G4double mean = sum/nEvents;
+    if(nSamples < 2) return std::make_pair(mean, -1.); // undefined (e.g. a single batch), not 0
+    G4double variance = (squaredSum/nEvents) - (mean * mean);
+    G4double relativeError = std::sqrt(variance/nSamples) / mean;
+
+    return std::make_pair(mean, relativeError);
+}
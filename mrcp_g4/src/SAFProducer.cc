@@ -0,0 +1,327 @@
+#include "SAFProducer.hh"
+#include "MRCPModel.hh"
+#include "MRCPProtQCalculator.hh"
+
+#include "G4UImanager.hh"
+#include "G4UIcommand.hh"
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <tuple>
+
+namespace
+{
+MRCPModel* GetMainPhantom()
+{
+    return dynamic_cast<MRCPModel*>(TETModelStore::GetInstance()->GetTETModel("MainPhantom"));
+}
+
+template<typename T> void WriteBinary(std::ostream& out, const T& value)
+{ out.write(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+void WriteBinary(std::ostream& out, const G4String& value)
+{
+    WriteBinary(out, static_cast<uint32_t>(value.size()));
+    out.write(value.data(), value.size());
+}
+}
+
+SAFProducer::SAFProducer()
+: fParticleName("gamma"), fEventsPerEnergy(1000000), fRecording(false), fSourceIndex(0), fEnergyIndex(0)
+{
+    // Commands of the master only (they drive the runs)
+    fMessenger = new G4GenericMessenger(this, "/MRCP/saf/", "Specific absorbed fraction production");
+
+    fMessenger->DeclareMethod("particle", &SAFProducer::SetParticle,
+                "Particle emitted in the source regions (default: gamma).").SetToBeBroadcasted(false);
+
+    fMessenger->DeclareMethod("eventsPerEnergy", &SAFProducer::SetEventsPerEnergy,
+                "Default number of histories per energy of a source region (default: 1000000).").SetToBeBroadcasted(false);
+
+    auto& addSourceCmd =
+            fMessenger->DeclareMethod("addSource", &SAFProducer::AddSource,
+                "Add a source region: an organ of the protection quantity definition, or subModel IDs separated by commas. "
+                "Usage: addSource Liver [eventsPerEnergy], addSource 89,95 [eventsPerEnergy]");
+    addSourceCmd.SetParameterName("source", false);
+    addSourceCmd.SetToBeBroadcasted(false);
+
+    auto& energiesCmd =
+            fMessenger->DeclareMethod("energies", &SAFProducer::SetEnergies,
+                "Energy grid. Usage: energies E1 E2 ... unit");
+    energiesCmd.SetParameterName("energies", false);
+    energiesCmd.SetToBeBroadcasted(false);
+
+    auto& logEnergiesCmd =
+            fMessenger->DeclareMethod("logEnergies", &SAFProducer::SetLogEnergies,
+                "Logarithmic energy grid. Usage: logEnergies Emin Emax nEnergies unit");
+    logEnergiesCmd.SetParameterName("energies", false);
+    logEnergiesCmd.SetToBeBroadcasted(false);
+
+    fMessenger->DeclareMethod("clear", &SAFProducer::Clear,
+                "Remove all source regions & energies.").SetToBeBroadcasted(false);
+
+    auto& runCmd =
+            fMessenger->DeclareMethod("run", &SAFProducer::Run,
+                "Run all (source, energy) pairs and write the SAFs to the binary file.");
+    runCmd.SetParameterName("outputFile", false);
+    runCmd.SetToBeBroadcasted(false);
+}
+
+SAFProducer::~SAFProducer()
+{
+    delete fMessenger;
+}
+
+void SAFProducer::SetEventsPerEnergy(const G4String& nEvents)
+{
+    std::istringstream iss(nEvents);
+    G4long value(0);
+    iss >> value;
+    if(iss.fail() || value <= 0)
+    {
+        G4Exception("SAFProducer::SetEventsPerEnergy()", "", JustWarning,
+            G4String("      invalid argument: " + nEvents).c_str());
+        return;
+    }
+    fEventsPerEnergy = value;
+}
+
+void SAFProducer::AddSource(const G4String& args)
+{
+    std::istringstream iss(args);
+    Source source;
+    source.nEventsPerEnergy = fEventsPerEnergy;
+    iss >> source.name;
+    if(!iss.eof()) iss >> source.nEventsPerEnergy;
+    if(iss.fail() || source.nEventsPerEnergy <= 0)
+    {
+        G4Exception("SAFProducer::AddSource()", "", JustWarning,
+            G4String("      invalid argument: " + args).c_str());
+        return;
+    }
+
+    // --- SubModels of the region --- //
+    auto protQCalculator = MRCPProtQCalculator::GetCalculator("MainPhantom");
+    source.isOrgan = protQCalculator && protQCalculator->HasOrgan(source.name);
+    if(source.isOrgan)
+        source.subModelIDs = protQCalculator->GetOrganSubModelIDs(source.name);
+    else
+    {
+        std::istringstream idss(source.name);
+        G4String id;
+        while(std::getline(idss, id, ','))
+        {
+            std::istringstream vss(id);
+            G4int subModelID;
+            vss >> subModelID;
+            if(vss.fail() || !vss.eof())
+            {
+                G4Exception("SAFProducer::AddSource()", "", JustWarning,
+                    G4String("      neither an organ nor subModel IDs: " + source.name).c_str());
+                return;
+            }
+            source.subModelIDs.insert(subModelID);
+        }
+    }
+
+    auto mrcpModel = GetMainPhantom();
+    source.mass = 0.;
+    for(const auto& subModelID: source.subModelIDs)
+        source.mass += mrcpModel ? mrcpModel->GetSubModelMass(subModelID) : 0.;
+    if(source.mass <= 0.)
+    {
+        G4Exception("SAFProducer::AddSource()", "", JustWarning,
+            G4String("      source region '" + source.name + "' has no mass").c_str());
+        return;
+    }
+
+    fSource_Vector.push_back(source);
+}
+
+void SAFProducer::SetEnergies(const G4String& args)
+{
+    std::istringstream iss(args);
+    std::vector<G4String> tokens;
+    for(G4String token; iss >> token; )
+        tokens.push_back(token);
+
+    std::vector<G4double> energies;
+    for(size_t i = 0; i + 1 < tokens.size(); ++i)
+    {
+        G4double energy = G4UIcommand::ConvertToDouble(tokens[i]) * G4UIcommand::ValueOf(tokens.back());
+        if(!(energy > 0.))
+        {
+            G4Exception("SAFProducer::SetEnergies()", "", JustWarning,
+                G4String("      invalid argument: " + args).c_str());
+            return;
+        }
+        energies.push_back(energy);
+    }
+    if(energies.empty())
+    {
+        G4Exception("SAFProducer::SetEnergies()", "", JustWarning,
+            G4String("      invalid argument: " + args).c_str());
+        return;
+    }
+    fEnergy_Vector = energies;
+}
+
+void SAFProducer::SetLogEnergies(const G4String& args)
+{
+    std::istringstream iss(args);
+    G4double minEnergy, maxEnergy;
+    G4int nEnergies;
+    G4String unit;
+    iss >> minEnergy >> maxEnergy >> nEnergies >> unit;
+    if(iss.fail() || minEnergy <= 0. || maxEnergy < minEnergy || nEnergies < 1)
+    {
+        G4Exception("SAFProducer::SetLogEnergies()", "", JustWarning,
+            G4String("      invalid argument: " + args).c_str());
+        return;
+    }
+
+    fEnergy_Vector.clear();
+    for(G4int i = 0; i < nEnergies; ++i)
+    {
+        G4double exponent = (nEnergies > 1) ? static_cast<G4double>(i) / (nEnergies - 1) : 0.;
+        fEnergy_Vector.push_back(minEnergy * std::pow(maxEnergy / minEnergy, exponent) * G4UIcommand::ValueOf(unit));
+    }
+}
+
+void SAFProducer::Clear()
+{
+    fSource_Vector.clear();
+    fEnergy_Vector.clear();
+}
+
+void SAFProducer::Run(const G4String& outputFileName)
+{
+    auto mrcpModel = GetMainPhantom();
+    if(!mrcpModel || fSource_Vector.empty() || fEnergy_Vector.empty())
+    {
+        G4Exception("SAFProducer::Run()", "", JustWarning,
+            "      no source region or energy (or the geometry is not initialized)");
+        return;
+    }
+
+    // --- Results: all targets (dose tallies), -1 error until recorded --- //
+    fTargetID_Vector.clear();
+    for(size_t i = 0; i < mrcpModel->GetNumDoseTallies(); ++i)
+        fTargetID_Vector.push_back(mrcpModel->GetDoseTallyID(i));
+    size_t nResults = fSource_Vector.size() * fEnergy_Vector.size() * fTargetID_Vector.size();
+    fSAF_Vector.assign(nResults, 0.f);
+    fRelativeError_Vector.assign(nResults, -1.f);
+
+    // --- Monoenergetic particles (no nuclide, no spectrum), a run per (source, energy) --- //
+    if(Apply("/gun/radioNuclide") && Apply("/gun/spectrum") && Apply("/gun/particle " + fParticleName))
+    {
+        for(fSourceIndex = 0; fSourceIndex < fSource_Vector.size(); ++fSourceIndex)
+        {
+            const auto& source = fSource_Vector[fSourceIndex];
+            G4String sourceCommand = "/gun/sourceOrgan " + source.name;
+            if(!source.isOrgan)
+            {
+                sourceCommand = "/gun/sourceSubModels";
+                for(const auto& subModelID: source.subModelIDs)
+                    sourceCommand += " " + std::to_string(subModelID);
+            }
+            if(!Apply(sourceCommand)) continue;
+
+            for(fEnergyIndex = 0; fEnergyIndex < fEnergy_Vector.size(); ++fEnergyIndex)
+            {
+                std::ostringstream energyCommand;
+                energyCommand.precision(std::numeric_limits<G4double>::max_digits10);
+                energyCommand << "/gun/energy " << fEnergy_Vector[fEnergyIndex]/MeV << " MeV";
+                if(!Apply(energyCommand.str())) continue;
+
+                G4cout << " SAF: source " << source.name << " (" << fSourceIndex + 1 << "/" << fSource_Vector.size()
+                       << "), " << fEnergy_Vector[fEnergyIndex]/MeV << " MeV (" << fEnergyIndex + 1 << "/" << fEnergy_Vector.size()
+                       << "), " << source.nEventsPerEnergy << " events" << G4endl;
+
+                fRecording = true;
+                if(source.nEventsPerEnergy > 2147483647)
+                    Apply("/MRCP/run/beamOnLong " + std::to_string(source.nEventsPerEnergy));
+                else
+                    Apply("/run/beamOn " + std::to_string(source.nEventsPerEnergy));
+                fRecording = false;
+            }
+        }
+        Apply("/gun/clearSourceVolume");
+    }
+
+    Write(outputFileName);
+}
+
+void SAFProducer::RecordRun(const RunTally& tally)
+{
+    if(!fRecording) return;
+
+    size_t nTargets = fTargetID_Vector.size();
+    if(tally.subModelDoseSum.size()!=nTargets || tally.nEvents==0) return;
+
+    // SAF (/kg) = dose per history / energy emitted
+    G4double energy = fEnergy_Vector[fEnergyIndex];
+    size_t offset = (fSourceIndex * fEnergy_Vector.size() + fEnergyIndex) * nTargets;
+    for(size_t i = 0; i < nTargets; ++i)
+    {
+        G4double meanDose, relativeError;
+        std::tie(meanDose, relativeError) =
+                GetMeanAndRelativeError(tally.subModelDoseSum[i], tally.subModelDoseSquaredSum[i], tally.nEvents, tally.nSamples);
+
+        fSAF_Vector[offset + i] = static_cast<G4float>(meanDose / energy * kg);
+        fRelativeError_Vector[offset + i] = static_cast<G4float>(relativeError);
+    }
+}
+
+G4bool SAFProducer::Apply(const G4String& command) const
+{
+    if(G4UImanager::GetUIpointer()->ApplyCommand(command)==0) return true;
+
+    G4Exception("SAFProducer::Apply()", "", JustWarning,
+        G4String("      failed: " + command).c_str());
+    return false;
+}
+
+void SAFProducer::Write(const G4String& outputFileName) const
+{
+    std::ofstream ofs(outputFileName, std::ios::binary);
+    if(!ofs.is_open())
+    {
+        G4Exception("SAFProducer::Write()", "", JustWarning,
+            G4String("      cannot open the output file '" + outputFileName + "'").c_str());
+        return;
+    }
+
+    auto mrcpModel = GetMainPhantom();
+
+    ofs.write("MRCP-SAF-1", 10);
+    WriteBinary(ofs, static_cast<uint32_t>(fSource_Vector.size()));
+    WriteBinary(ofs, static_cast<uint32_t>(fEnergy_Vector.size()));
+    WriteBinary(ofs, static_cast<uint32_t>(fTargetID_Vector.size()));
+    WriteBinary(ofs, fParticleName);
+
+    for(const auto& source: fSource_Vector)
+    {
+        WriteBinary(ofs, source.name);
+        WriteBinary(ofs, source.mass/kg);
+        WriteBinary(ofs, static_cast<int64_t>(source.nEventsPerEnergy));
+    }
+    for(const auto& energy: fEnergy_Vector)
+        WriteBinary(ofs, energy/MeV);
+    for(size_t i = 0; i < fTargetID_Vector.size(); ++i)
+    {
+        G4int tallyID = fTargetID_Vector[i];
+        WriteBinary(ofs, static_cast<int32_t>(tallyID));
+        WriteBinary(ofs, mrcpModel->GetDoseTallyName(i));
+        WriteBinary(ofs, (tallyID > 0) ? mrcpModel->GetSubModelMass(tallyID)/kg : 0.);
+    }
+
+    ofs.write(reinterpret_cast<const char*>(fSAF_Vector.data()), fSAF_Vector.size() * sizeof(G4float));
+    ofs.write(reinterpret_cast<const char*>(fRelativeError_Vector.data()), fRelativeError_Vector.size() * sizeof(G4float));
+
+    G4cout << " SAF: " << fSource_Vector.size() << " sources x " << fEnergy_Vector.size() << " energies x "
+           << fTargetID_Vector.size() << " targets written to '" << outputFileName << "'" << G4endl;
+}
@@ -0,0 +1,174 @@
+#include "SilhouetteSampler.hh"
+#include "TETModelStore.hh"
+
+#include "G4PhysicalVolumeStore.hh"
+#include "G4Threading.hh"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+SilhouetteSampler::SilhouetteSampler(const G4ThreeVector& referencePoint, const std::vector<G4ThreeVector>& hullNodes,
+                                     G4int nCosTheta, G4int nPhi)
+: fCosThetaMin(1.), fDCosTheta(0.), fDPhi(CLHEP::twopi / nPhi), fCellSolidAngle(0.), fNPhi(nPhi)
+{
+    if(hullNodes.empty()) return;
+
+    // --- Axis to the centroid of the hull nodes --- //
+    G4ThreeVector centroid;
+    for(const auto& node: hullNodes)
+        centroid += node;
+    centroid /= hullNodes.size();
+    if((centroid - referencePoint).mag2() <= 0.) return;
+
+    fAxis = (centroid - referencePoint).unit();
+    fU = fAxis.orthogonal().unit();
+    fV = fAxis.cross(fU);
+
+    // --- Gnomonic projection of the nodes (all in front of the point, unless the point is not outside the hull) --- //
+    std::vector< std::pair<G4double, G4double> > projected;
+    projected.reserve(hullNodes.size());
+    for(const auto& node: hullNodes)
+    {
+        G4ThreeVector toNode = node - referencePoint;
+        G4double z = toNode.dot(fAxis);
+        if(z <= 1e-9 * toNode.mag()) return;
+        projected.push_back(std::make_pair(toNode.dot(fU) / z, toNode.dot(fV) / z));
+    }
+
+    // --- Silhouette: 2D convex hull of the projected nodes (monotone chain, counterclockwise) --- //
+    std::sort(projected.begin(), projected.end());
+    projected.erase(std::unique(projected.begin(), projected.end()), projected.end());
+    auto cross = [](const std::pair<G4double, G4double>& o, const std::pair<G4double, G4double>& a,
+                    const std::pair<G4double, G4double>& b)
+    { return (a.first - o.first) * (b.second - o.second) - (a.second - o.second) * (b.first - o.first); };
+
+    std::vector< std::pair<G4double, G4double> > polygon(2 * projected.size());
+    size_t k = 0;
+    for(size_t i = 0; i < projected.size(); ++i) // lower hull
+    {
+        while(k >= 2 && cross(polygon[k-2], polygon[k-1], projected[i]) <= 0.) --k;
+        polygon[k++] = projected[i];
+    }
+    for(size_t i = projected.size() - 1, lower = k + 1; i-- > 0; ) // upper hull
+    {
+        while(k >= lower && cross(polygon[k-2], polygon[k-1], projected[i]) <= 0.) --k;
+        polygon[k++] = projected[i];
+    }
+    polygon.resize(projected.size() > 1 ? k - 1 : projected.size());
+
+    // --- Cone around the axis, divided into cells of equal solid angle --- //
+    G4double rhoMax = 0.;
+    for(const auto& vertex: polygon)
+        rhoMax = std::max(rhoMax, std::sqrt(vertex.first * vertex.first + vertex.second * vertex.second));
+    fCosThetaMin = std::cos(std::min(std::atan(rhoMax) * (1. + 1e-9) + 1e-12, CLHEP::halfpi));
+    fDCosTheta = (1. - fCosThetaMin) / nCosTheta;
+    fCellSolidAngle = fDCosTheta * fDPhi;
+
+    // --- Cells which may overlap the silhouette --- //
+    for(G4int i = 0; i < nCosTheta; ++i)
+    {
+        G4double rho1 = std::tan(std::acos(std::min(fCosThetaMin + (i+1) * fDCosTheta, 1.)));
+        G4double rho2 = std::tan(std::acos(fCosThetaMin + i * fDCosTheta));
+        for(G4int j = 0; j < nPhi; ++j)
+            if(IsCellOverlapping(polygon, rho1, rho2, j * fDPhi, (j+1) * fDPhi))
+                fAcceptedCell_Vector.push_back(i * nPhi + j);
+    }
+}
+
+G4bool SilhouetteSampler::IsCellOverlapping(const std::vector< std::pair<G4double, G4double> >& polygon,
+                                            G4double rho1, G4double rho2, G4double phi1, G4double phi2)
+{
+    // The cell (annular sector in the projection plane) is bounded by a circle around its corners & outer arc midpoint,
+    // enlarged by the sagitta of the arcs
+    std::vector< std::pair<G4double, G4double> > points;
+    for(G4double rho: {rho1, rho2})
+        for(G4double phi: {phi1, phi2})
+            points.push_back(std::make_pair(rho * std::cos(phi), rho * std::sin(phi)));
+    points.push_back(std::make_pair(rho2 * std::cos(0.5 * (phi1 + phi2)), rho2 * std::sin(0.5 * (phi1 + phi2))));
+
+    G4double cx = 0., cy = 0.;
+    for(const auto& point: points)
+    {
+        cx += point.first / points.size();
+        cy += point.second / points.size();
+    }
+    G4double radius = 0.;
+    for(const auto& point: points)
+        radius = std::max(radius, std::hypot(point.first - cx, point.second - cy));
+    radius += rho2 * (1. - std::cos(0.5 * (phi2 - phi1))) + 1e-9 * rho2 + 1e-12;
+
+    // Circle center inside the (counterclockwise) polygon, or an edge within the radius
+    G4bool inside = polygon.size() >= 3;
+    for(size_t i = 0; i < polygon.size(); ++i)
+    {
+        const auto& a = polygon[i];
+        const auto& b = polygon[(i+1) % polygon.size()];
+        G4double ex = b.first - a.first, ey = b.second - a.second;
+        if(ex * (cy - a.second) - ey * (cx - a.first) < 0.) inside = false;
+
+        G4double length2 = ex * ex + ey * ey;
+        G4double t = (length2 > 0.) ? ((cx - a.first) * ex + (cy - a.second) * ey) / length2 : 0.;
+        t = std::min(std::max(t, 0.), 1.);
+        if(std::hypot(a.first + t * ex - cx, a.second + t * ey - cy) <= radius) return true;
+    }
+    return inside;
+}
+
+G4ThreeVector SampleDirectionToSilhouette(const G4ThreeVector& referencePoint,
+                                          const G4String& tetModelName,
+                                          const G4String& physicalVolumeName,
+                                          G4double& particleWeight)
+{
+    // Hull nodes in the world, & a sampler per source position (per thread)
+    struct SilhouetteCache
+    {
+        G4String tetModelName;
+        G4String physicalVolumeName;
+        std::vector<G4ThreeVector> hullNode_Vector;
+        std::map<std::tuple<G4double, G4double, G4double>, SilhouetteSampler> sampler_Map;
+    };
+    static G4ThreadLocal SilhouetteCache* cache = nullptr;
+    if(!cache) cache = new SilhouetteCache;
+
+    if(cache->tetModelName!=tetModelName || cache->physicalVolumeName!=physicalVolumeName)
+    {
+        cache->tetModelName = tetModelName;
+        cache->physicalVolumeName = physicalVolumeName;
+        cache->hullNode_Vector.clear();
+        cache->sampler_Map.clear();
+
+        auto tetModel = TETModelStore::GetInstance()->GetTETModel(tetModelName);
+        auto physicalVolume = G4PhysicalVolumeStore::GetInstance()->GetVolume(physicalVolumeName);
+        if(!tetModel || !physicalVolume)
+            G4Exception("SampleDirectionToSilhouette()", "", JustWarning,
+                G4String("      invalid TETModel '" + tetModelName + "' or physical volume '" + physicalVolumeName + "'").c_str());
+        else
+        {
+            auto rotation = physicalVolume->GetObjectRotationValue();
+            auto translation = physicalVolume->GetObjectTranslation();
+            for(const auto& node: tetModel->GetHullNodes())
+                cache->hullNode_Vector.push_back(rotation * node + translation);
+        }
+    }
+
+    // Positions are few (/gun/position, /gun/addPosition)
+    auto key = std::make_tuple(referencePoint.x(), referencePoint.y(), referencePoint.z());
+    auto sampler = cache->sampler_Map.find(key);
+    if(sampler==cache->sampler_Map.end())
+    {
+        if(cache->sampler_Map.size() >= 1024) cache->sampler_Map.clear();
+        sampler = cache->sampler_Map.emplace(key, SilhouetteSampler(referencePoint, cache->hullNode_Vector)).first;
+
+        if(G4Threading::G4GetThreadId() <= 0)
+        {
+            if(sampler->second.IsBiased())
+                G4cout << " Silhouette biasing at " << referencePoint/cm << " cm: "
+                       << sampler->second.GetAcceptedSolidAngle() / (4 * CLHEP::pi) << " of 4pi" << G4endl;
+            else
+                G4cout << " Silhouette biasing at " << referencePoint/cm << " cm: not outside the hull, isotropic" << G4endl;
+        }
+    }
+
+    return sampler->second.Sample(particleWeight);
+}
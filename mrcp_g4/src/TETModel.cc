@@ -1,6 +1,8 @@
 #include "TETModel.hh"
 #include "TETModelStore.hh"
 
+#include <algorithm>
+
 TETModel::TETModel(G4String name,
     const G4String& nodeFilePath, const G4String& eleFilePath,
     const G4String& colourFilePath)
@@ -84,6 +86,12 @@ G4bool TETModel::IsInside(const G4ThreeVector pt)
     return false;
 }
 
+const std::vector<G4ThreeVector>& TETModel::GetHullNodes() const
+{
+    std::call_once(fHullNodeFlag, [this]() { CalculateHullNodes(); });
+    return hullNode_Vector;
+}
+
 // --- Private functions --- //
 void TETModel::ImportNodeData(const G4String& nodeFilePath)
 {
@@ -173,7 +181,7 @@ void TETModel::ImportEleData(const G4String& eleFilePath)
             );
 
         subModelID_Set.insert(subModelID);
-        tetID_subModelID_Map[i] = subModelID;
+        tetSubModelID_Vector.push_back(subModelID);
     }
 
     // --- Close the file --- //
@@ -219,7 +227,7 @@ void TETModel::CalculateModelDetails()
     for(size_t i = 0; i < tet_Vector.size(); ++i)
     {
         G4double tetVolume = tet_Vector[i]->GetCubicVolume();
-        G4int subModelID = tetID_subModelID_Map[static_cast<G4int>(i)];
+        G4int subModelID = tetSubModelID_Vector[i];
 
         subModelVolume_Map[subModelID] += tetVolume;
         ++subModelNumTets_Map[subModelID];
@@ -228,6 +236,74 @@ void TETModel::CalculateModelDetails()
     }
 }
 
+void TETModel::CalculateHullNodes() const
+{
+    if(node_Vector.size() < 4)
+    {
+        for(const auto& node: node_Vector)
+            hullNode_Vector.push_back(node - fBoundingBoxCen);
+        return;
+    }
+
+    // --- Extreme nodes in directions spread over the sphere (Fibonacci lattice), all on the hull --- //
+    const G4int nDirections = 64;
+    std::vector<size_t> extreme_Vector;
+    for(G4int i = 0; i < nDirections; ++i)
+    {
+        G4double cosTheta = 1. - (2. * i + 1.) / nDirections;
+        G4double sinTheta = std::sqrt(1. - cosTheta * cosTheta);
+        G4double phi = i * CLHEP::pi * (3. - std::sqrt(5.));
+        G4ThreeVector direction(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+
+        size_t extreme = 0;
+        for(size_t j = 1; j < node_Vector.size(); ++j)
+            if(node_Vector[j].dot(direction) > node_Vector[extreme].dot(direction)) extreme = j;
+        if(std::find(extreme_Vector.begin(), extreme_Vector.end(), extreme)==extreme_Vector.end())
+            extreme_Vector.push_back(extreme);
+    }
+
+    // --- Facets of their convex hull (inscribed in the hull of all nodes), by brute force --- //
+    G4double tolerance = 1e-9 * fBoundingBoxSize.mag();
+    std::vector< std::pair<G4ThreeVector, G4double> > facet_Vector; // outward unit normal, distance
+    for(size_t i = 0; i < extreme_Vector.size(); ++i)
+        for(size_t j = i+1; j < extreme_Vector.size(); ++j)
+            for(size_t k = j+1; k < extreme_Vector.size(); ++k)
+            {
+                const auto& p0 = node_Vector[extreme_Vector[i]];
+                G4ThreeVector normal = (node_Vector[extreme_Vector[j]] - p0).cross(node_Vector[extreme_Vector[k]] - p0);
+                if(normal.mag() < tolerance * tolerance) continue;
+                normal = normal.unit();
+
+                G4bool below = true, above = true;
+                for(const auto& extreme: extreme_Vector)
+                {
+                    G4double distance = normal.dot(node_Vector[extreme] - p0);
+                    if(distance > tolerance) below = false;
+                    if(distance < -tolerance) above = false;
+                }
+                if(!below && !above) continue;
+                if(!below) normal = -normal;
+
+                G4bool duplicated = false;
+                for(const auto& facet: facet_Vector)
+                    if((facet.first - normal).mag() < 1e-9 && std::abs(facet.second - normal.dot(p0)) < tolerance)
+                        duplicated = true;
+                if(!duplicated) facet_Vector.push_back(std::make_pair(normal, normal.dot(p0)));
+            }
+
+    // --- Nodes not strictly inside the inscribed polytope --- //
+    for(const auto& node: node_Vector)
+    {
+        G4bool inside = !facet_Vector.empty();
+        for(const auto& facet: facet_Vector)
+            if(facet.first.dot(node) - facet.second > -tolerance) { inside = false; break; }
+        if(!inside) hullNode_Vector.push_back(node - fBoundingBoxCen);
+    }
+
+    G4cout << "  " << fModelName << ": " << hullNode_Vector.size() << " of " << node_Vector.size()
+           << " nodes may be on the convex hull" << G4endl;
+}
+
 // --- Additional Functions --- //
 G4ThreeVector SampleRndPointInTet(const G4Tet* tet)
 {
@@ -256,11 +332,12 @@ G4ThreeVector SampleRndPointInTet(const G4Tet* tet)
     }
 
     G4double c0 = 1. - c1 - c2 - c3;
+    auto vertices = tet->GetVertices(); // by value
     G4ThreeVector rndPoint =
-            tet->GetVertices().at(0) * c0 +
-            tet->GetVertices().at(1) * c1 +
-            tet->GetVertices().at(2) * c2 +
-            tet->GetVertices().at(3) * c3;
+            vertices.at(0) * c0 +
+            vertices.at(1) * c1 +
+            vertices.at(2) * c2 +
+            vertices.at(3) * c3;
 
     return rndPoint;
 }
@@ -1,6 +1,9 @@
 #include "TETParameterisation.hh"
 #include "TETModelStore.hh"
-#include "MRCPModel.hh"
+#include "NUMAReplica.hh"
+
+#include "G4Threading.hh"
+#include "G4VVisManager.hh"
 
 TETParameterisation::TETParameterisation(G4String tetModelName)
 : G4VPVParameterisation()
@@ -12,6 +15,9 @@ TETParameterisation::TETParameterisation(G4String tetModelName)
     for(const auto& subModelID: fTETModel->GetSubModelIDSet())
         subModelVisAttributes_Map[subModelID] =
             new G4VisAttributes(fTETModel->GetSubModelColour(subModelID));
+
+    // Shared replica (incl. the material of each tet) is built here, by the master
+    NUMAReplicaStore::GetInstance()->GetLocalReplica(fTETModel);
 }
 
 TETParameterisation::~TETParameterisation()
@@ -20,21 +26,31 @@ TETParameterisation::~TETParameterisation()
 G4VSolid* TETParameterisation::ComputeSolid(const G4int copyNo, G4VPhysicalVolume*)
 {
     // return G4Tet*
-    return fTETModel->GetTetrahedron(copyNo);
+    return const_cast<G4Tet*>(GetLocalReplica()->tets[copyNo]);
 }
 
 G4Material* TETParameterisation::ComputeMaterial(
     const G4int copyNo, G4VPhysicalVolume* phy, const G4VTouchable*)
 {
-    G4int subModelID = fTETModel->GetSubModelID(copyNo);
-
-    // Set VisAttributes
-    phy->GetLogicalVolume()->SetVisAttributes(subModelVisAttributes_Map.at(subModelID));
-
-    // If the model is MRCPModel, replace its material to MRCP material.
-    MRCPModel* mrcpModel = dynamic_cast<MRCPModel*>(fTETModel);
-    if(mrcpModel) return mrcpModel->GetSubModelMaterial(subModelID);
+    // Set VisAttributes only for the visualization by the master: the vis manager is process-wide, and
+    // the workers would write the shared logical volume during tracking
+    if(G4Threading::IsMasterThread() && G4VVisManager::GetConcreteInstance())
+        phy->GetLogicalVolume()->SetVisAttributes(subModelVisAttributes_Map.at(fTETModel->GetSubModelID(copyNo)));
+
+    // Tracking path: a single table lookup
+    G4Material* tetMaterial = GetLocalReplica()->materials[copyNo];
+    if(tetMaterial) return tetMaterial;
     else return phy->GetLogicalVolume()->GetMaterial();
 }
 
-
+const TETModelReplica* TETParameterisation::GetLocalReplica() const
+{
+    static G4ThreadLocal const TETParameterisation* cachedParameterisation = nullptr;
+    static G4ThreadLocal const TETModelReplica* cachedReplica = nullptr;
+    if(cachedParameterisation!=this)
+    {
+        cachedReplica = NUMAReplicaStore::GetInstance()->GetLocalReplica(fTETModel);
+        cachedParameterisation = this;
+    }
+    return cachedReplica;
+}
@@ -33,7 +33,9 @@
 TETSteppingAction::TETSteppingAction()
 : G4UserSteppingAction(), kCarTolerance(1.0000000000000002e-07),
   stepCounter(0), checkFlag(0)
-{}
+{
+	phaseSpaceWriter = PhaseSpaceWriter::GetInstance();
+}
 
 TETSteppingAction::~TETSteppingAction()
 {}
@@ -65,4 +67,8 @@ void TETSteppingAction::UserSteppingAction(const G4Step* step)
 		}
 	}
 	else stepCounter=0;
+
+	// Record the particle if it enters the phantom box (first stage of a two-stage simulation)
+	//
+	if(phaseSpaceWriter->IsWriting()) phaseSpaceWriter->Record(step);
 }
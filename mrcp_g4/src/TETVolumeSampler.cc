@@ -0,0 +1,48 @@
+#include "TETVolumeSampler.hh"
+#include "TETModelStore.hh"
+
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+const TETVolumeSampler* TETVolumeSampler::GetSampler(const G4String& tetModelName, const std::set<G4int>& subModelIDs)
+{
+    static std::mutex samplerMutex;
+    static std::map< G4String, std::unique_ptr<const TETVolumeSampler> > sampler_Map;
+
+    std::ostringstream key;
+    key << tetModelName;
+    for(const auto& subModelID: subModelIDs)
+        key << " " << subModelID;
+
+    std::lock_guard<std::mutex> lock(samplerMutex);
+    auto& sampler = sampler_Map[key.str()];
+    if(!sampler)
+    {
+        auto tetModel = TETModelStore::GetInstance()->GetTETModel(tetModelName);
+        if(!tetModel) return nullptr;
+        sampler.reset(new TETVolumeSampler(tetModel, subModelIDs));
+    }
+    return sampler->fTet_Vector.empty() ? nullptr : sampler.get();
+}
+
+TETVolumeSampler::TETVolumeSampler(const TETModel* tetModel, const std::set<G4int>& subModelIDs)
+: fVolume(0.)
+{
+    const auto& tet_Vector = tetModel->GetTetVector();
+    const auto& tetSubModelID_Vector = tetModel->GetTetSubModelIDVector();
+
+    std::vector<G4double> tetVolume_Vector;
+    for(size_t i = 0; i < tet_Vector.size(); ++i)
+    {
+        if(subModelIDs.find(tetSubModelID_Vector[i])==subModelIDs.end()) continue;
+
+        G4double tetVolume = tet_Vector[i]->GetCubicVolume();
+        fTet_Vector.push_back(tet_Vector[i]);
+        tetVolume_Vector.push_back(tetVolume);
+        fVolume += tetVolume;
+    }
+
+    if(!fTet_Vector.empty())
+        fAliasTable = AliasTable(tetVolume_Vector);
+}
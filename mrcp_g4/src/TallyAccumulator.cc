@@ -0,0 +1,127 @@
+#include "TallyAccumulator.hh"
+#include "MRCPProtQCalculator.hh"
+#include "MRCPModel.hh"
+
+TallyAccumulator::TallyAccumulator(G4int batchSize)
+: fPositionIndex(-1), fBatchSize(batchSize)
+{
+    // --- MRCPCalculator (shared, read-only) --- //
+    mainPhantomProtQ = MRCPProtQCalculator::GetCalculator("MainPhantom");
+
+    // --- SubModel dose tally --- //
+    auto mrcpModel = dynamic_cast<MRCPModel*>(TETModelStore::GetInstance()->GetTETModel("MainPhantom"));
+
+    fTally.Resize(mainPhantomProtQ->GetNumProtQ(), mrcpModel->GetNumDoseTallies());
+    fPending.subModelDose.assign(mrcpModel->GetNumDoseTallies(), 0.);
+    fPending.flags.assign(mrcpModel->GetNumDoseTallies(), false);
+    fPendingProtQ.assign(mainPhantomProtQ->GetNumProtQ(), 0.);
+}
+
+void TallyAccumulator::SetPositionIndex(G4int positionIndex)
+{
+    if(positionIndex < 0) return;
+
+    size_t nPositions = static_cast<size_t>(positionIndex) + 1;
+    if(nPositions > fPositionPending_Vector.size())
+    {
+        PendingSample emptySample;
+        emptySample.subModelDose.assign(fPending.subModelDose.size(), 0.);
+        emptySample.flags.assign(fPending.flags.size(), false);
+        fPositionPending_Vector.resize(nPositions, emptySample);
+        fTally.ResizePositions(nPositions);
+    }
+    fPositionIndex = positionIndex;
+}
+
+void TallyAccumulator::EndOfEvent()
+{
+    ++fPending.nEvents;
+
+    // History-by-history: every event is a sample. Batch mode: every fBatchSize events.
+    // (the last, unfinished batch is added by GetTally())
+    if(IsSampleComplete(fPending))
+    {
+        AddPendingTo(fTally, fPendingProtQ);
+        fPending.Clear();
+    }
+
+    // Same for the source position of the event
+    if(fPositionIndex >= 0)
+    {
+        auto& positionPending = fPositionPending_Vector[fPositionIndex];
+        ++positionPending.nEvents;
+        if(IsSampleComplete(positionPending))
+        {
+            AddPositionPendingTo(fTally, static_cast<size_t>(fPositionIndex), fPendingProtQ);
+            positionPending.Clear();
+        }
+        fPositionIndex = -1;
+    }
+}
+
+RunTally TallyAccumulator::GetTally() const
+{
+    RunTally tally = fTally;
+    std::vector<G4double> protQBuffer(mainPhantomProtQ->GetNumProtQ());
+    AddPendingTo(tally, protQBuffer);
+    for(size_t i = 0; i < fPositionPending_Vector.size(); ++i)
+        AddPositionPendingTo(tally, i, protQBuffer);
+    return tally;
+}
+
+void TallyAccumulator::AddPendingTo(RunTally& tally, std::vector<G4double>& protQ) const
+{
+    if(fPending.nEvents==0) return;
+
+    // Calculate protection quantities of the pending sample (protQ = W * subModelDose)
+    mainPhantomProtQ->Evaluate(fPending.subModelDose.data(), protQ.data());
+
+    // Store the quantities and their squared values (divided by the number of events in the sample)
+    G4double nEvents = static_cast<G4double>(fPending.nEvents);
+    for(size_t i = 0; i < protQ.size(); ++i)
+    {
+        tally.protQSum[i] += protQ[i];
+        tally.protQSquaredSum[i] += protQ[i] * protQ[i] / nEvents;
+    }
+
+    for(const auto& tallyIndex: fPending.tallyIndices)
+    {
+        G4double subModelDose = fPending.subModelDose[tallyIndex];
+        tally.subModelDoseSum[tallyIndex] += subModelDose;
+        tally.subModelDoseSquaredSum[tallyIndex] += subModelDose * subModelDose / nEvents;
+    }
+
+    tally.nEvents += fPending.nEvents;
+    ++tally.nSamples;
+}
+
+void TallyAccumulator::AddPositionPendingTo(RunTally& tally, size_t positionIndex, std::vector<G4double>& protQ) const
+{
+    const auto& positionPending = fPositionPending_Vector[positionIndex];
+    if(positionPending.nEvents==0) return;
+
+    // Protection quantities only (subModel doses are not tallied per position)
+    mainPhantomProtQ->Evaluate(positionPending.subModelDose.data(), protQ.data());
+
+    G4double nEvents = static_cast<G4double>(positionPending.nEvents);
+    size_t offset = positionIndex * protQ.size();
+    for(size_t i = 0; i < protQ.size(); ++i)
+    {
+        tally.positionProtQSum[offset + i] += protQ[i];
+        tally.positionProtQSquaredSum[offset + i] += protQ[i] * protQ[i] / nEvents;
+    }
+
+    tally.positionNEvents[positionIndex] += positionPending.nEvents;
+    ++tally.positionNSamples[positionIndex];
+}
+
+void TallyAccumulator::PendingSample::Clear()
+{
+    for(const auto& tallyIndex: tallyIndices)
+    {
+        subModelDose[tallyIndex] = 0.;
+        flags[tallyIndex] = false;
+    }
+    tallyIndices.clear();
+    nEvents = 0;
+}
@@ -0,0 +1,108 @@
+#include "TallyReducer.hh"
+#include "RunMonitor.hh"
+
+#include <chrono>
+
+DoseRingBuffer::DoseRingBuffer(size_t capacity)
+: fBuffer(capacity), fMask(capacity - 1), fHead(0), fCachedTail(0), fTail(0)
+{}
+
+TallyReducer::Producer::Producer(G4int threadID, G4int batchSize)
+: fThreadID(threadID), fRingBuffer(1 << 16), fAccumulator(batchSize), fNPushedEvents(0), fNReducedEvents(0),
+  fEventsSincePublish(0)
+{}
+
+RunTally TallyReducer::Producer::GetReducedTally() const
+{
+    while(fNReducedEvents.load(std::memory_order_acquire) < fNPushedEvents)
+        std::this_thread::yield();
+    return fAccumulator.GetTally();
+}
+
+size_t TallyReducer::Producer::Reduce()
+{
+    // Read while reducing, not at Start(): the run monitor settings are final only when the run begins
+    G4int publishInterval = RunMonitor::GetInstance()->GetPublishInterval();
+    G4long nReducedEvents = 0;
+    size_t nEntries = fRingBuffer.ConsumeAll([&](const DoseRingBuffer::Entry& entry)
+    {
+        if(entry.tallyIndex==DoseRingBuffer::kPositionIndex)
+        {
+            fAccumulator.SetPositionIndex(static_cast<G4int>(entry.dose));
+            return;
+        }
+        if(entry.tallyIndex!=DoseRingBuffer::kEndOfEvent)
+        {
+            fAccumulator.AddDose(entry.tallyIndex, entry.dose);
+            return;
+        }
+
+        fAccumulator.EndOfEvent();
+        ++nReducedEvents;
+
+        // Partial tallies go to the run monitor from here, as the worker does not hold them
+        if(publishInterval > 0 && ++fEventsSincePublish >= publishInterval)
+        {
+            RunMonitor::GetInstance()->Publish(fThreadID, fAccumulator.GetTally(), std::vector<unsigned long>());
+            fEventsSincePublish = 0;
+        }
+    });
+
+    if(nReducedEvents > 0)
+        fNReducedEvents.fetch_add(nReducedEvents, std::memory_order_release);
+    return nEntries;
+}
+
+void TallyReducer::Start(G4int nThreads, G4int workersPerReducer, G4int batchSize)
+{
+    Stop();
+    if(workersPerReducer <= 0) return;
+
+    // A producer per thread (workers are not running at this point)
+    fProducers.clear();
+    for(G4int threadID = -1; threadID < nThreads; ++threadID)
+        fProducers.emplace_back(new Producer(threadID, batchSize));
+
+    // A reducer thread per group of workers
+    fReducerRunning = true;
+    for(size_t first = 0; first < fProducers.size(); first += static_cast<size_t>(workersPerReducer))
+    {
+        size_t last = std::min(first + static_cast<size_t>(workersPerReducer), fProducers.size());
+        fReducerThreads.emplace_back(&TallyReducer::ReducerLoop, this, first, last);
+    }
+}
+
+void TallyReducer::Stop()
+{
+    // All producers have been drained by Run::GetTally() (merge) at this point
+    fReducerRunning = false;
+    for(auto& reducerThread: fReducerThreads)
+        reducerThread.join();
+    fReducerThreads.clear();
+}
+
+TallyReducer::Producer* TallyReducer::GetProducer(G4int threadID)
+{
+    size_t producerIndex = static_cast<size_t>(threadID + 1);
+    if(!IsRunning() || producerIndex >= fProducers.size()) return nullptr;
+    return fProducers[producerIndex].get();
+}
+
+void TallyReducer::ReducerLoop(size_t firstProducer, size_t lastProducer)
+{
+    G4int nIdlePasses = 0;
+    while(fReducerRunning.load(std::memory_order_relaxed))
+    {
+        size_t nEntries = 0;
+        for(size_t i = firstProducer; i < lastProducer; ++i)
+            nEntries += fProducers[i]->Reduce();
+
+        // Back off while the workers are not producing
+        if(nEntries > 0)
+            nIdlePasses = 0;
+        else if(++nIdlePasses < 100)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
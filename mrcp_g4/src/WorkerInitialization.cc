@@ -0,0 +1,26 @@
+#include "WorkerInitialization.hh"
+#include "NUMAReplica.hh"
+#include "TETModelStore.hh"
+
+WorkerInitialization::WorkerInitialization(G4bool pinThreads)
+: G4UserWorkerInitialization(), fPinThreads(pinThreads)
+{}
+
+WorkerInitialization::~WorkerInitialization()
+{}
+
+void WorkerInitialization::WorkerInitialize() const
+{
+    // Before anything is allocated by this worker
+    if(fPinThreads)
+        NUMAReplicaStore::PinWorkerThread(G4Threading::G4GetThreadId());
+}
+
+void WorkerInitialization::WorkerRunStart() const
+{
+    // Build the local replicas before the first event (no-op if they exist or replicas are disabled)
+    auto replicaStore = NUMAReplicaStore::GetInstance();
+    if(!replicaStore->IsReplicaEnabled()) return;
+    for(const auto& tetModel: *TETModelStore::GetInstance())
+        replicaStore->GetLocalReplica(tetModel);
+}